@@ -17,6 +17,13 @@
  * @cpu_prepare:	Early one-time preparation step for a cpu. If there
  *			is a mechanism for doing so, tests whether it is
  *			possible to boot the given HART.
+ * @cpu_prestart:	Optional. Starts a cpu ahead of cpu_start and leaves
+ *			it spinning until cpu_start hands it its idle task,
+ *			so that the firmware start latency of all secondary
+ *			cpus overlaps at boot.
+ * @cpu_prestart_cancel: Optional. Stops a cpu that cpu_prestart started
+ *			but that was never handed to cpu_start, e.g. because
+ *			bringing it up failed early.
  * @cpu_start:		Boots a cpu into the kernel.
  * @cpu_disable:	Prepares a cpu to die. May fail for some
  *			mechanism-specific reason, which will cause the hot
@@ -29,6 +36,8 @@
 struct cpu_operations {
 	const char	*name;
 	int		(*cpu_prepare)(unsigned int cpu);
+	int		(*cpu_prestart)(unsigned int cpu);
+	void		(*cpu_prestart_cancel)(unsigned int cpu);
 	int		(*cpu_start)(unsigned int cpu,
 				     struct task_struct *tidle);
 #ifdef CONFIG_HOTPLUG_CPU
@@ -5,6 +5,9 @@
 #ifndef __ASM_CPU_OPS_SBI_H
 #define __ASM_CPU_OPS_SBI_H
 
+/* task_ptr value telling a prestarted hart to stop instead of booting */
+#define SBI_HART_BOOT_STOP	(-1)
+
 #ifndef __ASSEMBLY__
 #include <linux/init.h>
 #include <linux/sched.h>
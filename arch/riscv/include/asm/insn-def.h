@@ -87,6 +87,9 @@
 #define RV___RS1(v)		__RV_REG(v)
 #define RV___RS2(v)		__RV_REG(v)
 
+#define RV_OPCODE_LOAD_FP	RV_OPCODE(7)
+#define RV_OPCODE_STORE_FP	RV_OPCODE(39)
+#define RV_OPCODE_OP_V		RV_OPCODE(87)
 #define RV_OPCODE_SYSTEM	RV_OPCODE(115)
 
 #define HFENCE_VVMA(vaddr, asid)				\
@@ -134,4 +137,58 @@
 	INSN_R(OPCODE_SYSTEM, FUNC3(0), FUNC7(51),		\
 	       __RD(0), RS1(gaddr), RS2(vmid))
 
+/*
+ * Vector 0.7.1 instructions, as implemented by the T-HEAD C9xx cores.
+ * Vector register numbers are passed as plain numbers and end up in the
+ * register fields of the R-type word; vsetvli's vtype immediate spills
+ * from the rs2 field into func7.
+ */
+#define VSETVLI_E8M1(vl, avl)					\
+	INSN_R(OPCODE_OP_V, FUNC3(7), FUNC7(0),			\
+	       RD(vl), RS1(avl), __RS2(0))
+
+#define VSETVLI_E8M4(vl, avl)					\
+	INSN_R(OPCODE_OP_V, FUNC3(7), FUNC7(0),			\
+	       RD(vl), RS1(avl), __RS2(2))
+
+#define VLB_V(vd, base)						\
+	INSN_R(OPCODE_LOAD_FP, FUNC3(0), FUNC7(9),		\
+	       __RD(vd), RS1(base), __RS2(0))
+
+#define VSB_V(vs3, base)					\
+	INSN_R(OPCODE_STORE_FP, FUNC3(0), FUNC7(1),		\
+	       __RD(vs3), RS1(base), __RS2(0))
+
+#define VADD_VV(vd, vs2, vs1)					\
+	INSN_R(OPCODE_OP_V, FUNC3(0), FUNC7(1),			\
+	       __RD(vd), __RS1(vs1), __RS2(vs2))
+
+#define VXOR_VV(vd, vs2, vs1)					\
+	INSN_R(OPCODE_OP_V, FUNC3(0), FUNC7(23),		\
+	       __RD(vd), __RS1(vs1), __RS2(vs2))
+
+#define VMV_V_V(vd, vs1)					\
+	INSN_R(OPCODE_OP_V, FUNC3(0), FUNC7(47),		\
+	       __RD(vd), __RS1(vs1), __RS2(0))
+
+#define VRGATHER_VV(vd, vs2, vs1)				\
+	INSN_R(OPCODE_OP_V, FUNC3(0), FUNC7(25),		\
+	       __RD(vd), __RS1(vs1), __RS2(vs2))
+
+#define VAND_VX(vd, vs2, rs1)					\
+	INSN_R(OPCODE_OP_V, FUNC3(4), FUNC7(19),		\
+	       __RD(vd), RS1(rs1), __RS2(vs2))
+
+#define VAND_VI(vd, vs2, imm)					\
+	INSN_R(OPCODE_OP_V, FUNC3(3), FUNC7(19),		\
+	       __RD(vd), __RS1(imm), __RS2(vs2))
+
+#define VSRL_VI(vd, vs2, imm)					\
+	INSN_R(OPCODE_OP_V, FUNC3(3), FUNC7(81),		\
+	       __RD(vd), __RS1(imm), __RS2(vs2))
+
+#define VSRA_VI(vd, vs2, imm)					\
+	INSN_R(OPCODE_OP_V, FUNC3(3), FUNC7(83),		\
+	       __RD(vd), __RS1(imm), __RS2(vs2))
+
 #endif /* __ASM_INSN_DEF_H */
@@ -36,6 +36,9 @@
 	KVM_ARCH_REQ_FLAGS(4, KVM_REQUEST_WAIT | KVM_REQUEST_NO_WAKEUP)
 #define KVM_REQ_HFENCE			\
 	KVM_ARCH_REQ_FLAGS(5, KVM_REQUEST_WAIT | KVM_REQUEST_NO_WAKEUP)
+#define KVM_REQ_STEAL_UPDATE		KVM_ARCH_REQ(6)
+
+#define INVALID_GPA			(~(gpa_t)0)
 
 enum kvm_riscv_hfence_type {
 	KVM_RISCV_HFENCE_UNKNOWN = 0,
@@ -53,10 +56,15 @@ struct kvm_riscv_hfence {
 	gpa_t size;
 };
 
-#define KVM_RISCV_VCPU_MAX_HFENCE	64
+#define KVM_RISCV_VCPU_MAX_HFENCE	128
+
+/* Number of most recent queue entries checked when coalescing */
+#define KVM_RISCV_HFENCE_MERGE_WINDOW	8
 
 struct kvm_vm_stat {
 	struct kvm_vm_stat_generic generic;
+	u64 gstage_splits;
+	u64 gstage_tlb_sanitize;
 };
 
 struct kvm_vcpu_stat {
@@ -69,6 +77,14 @@ struct kvm_vcpu_stat {
 	u64 csr_exit_kernel;
 	u64 signal_exits;
 	u64 exits;
+	u64 hfence_enqueued;
+	u64 hfence_merged;
+	u64 hfence_overflow;
+	u64 hfence_flush_all;
+	u64 timer_set_exits;
+	u64 timer_hrtimer_armed;
+	u64 timer_hrtimer_avoided;
+	u64 wfi_timer_polls;
 };
 
 struct kvm_arch_memory_slot {
@@ -91,6 +107,9 @@ struct kvm_arch {
 	pgd_t *pgd;
 	phys_addr_t pgd_phys;
 
+	/* Page tables for eager block splitting, under kvm->slots_lock */
+	struct kvm_mmu_memory_cache split_page_cache;
+
 	/* Guest Timer */
 	struct kvm_guest_timer timer;
 };
@@ -208,6 +227,7 @@ struct kvm_vcpu_arch {
 	spinlock_t hfence_lock;
 	unsigned long hfence_head;
 	unsigned long hfence_tail;
+	unsigned long hfence_pending_pages;
 	struct kvm_riscv_hfence hfence_queue[KVM_RISCV_VCPU_MAX_HFENCE];
 
 	/* MMIO instruction details */
@@ -222,6 +242,12 @@ struct kvm_vcpu_arch {
 	/* Cache pages needed to program page tables with spinlock held */
 	struct kvm_mmu_memory_cache mmu_page_cache;
 
+	/* SBI steal-time accounting */
+	struct {
+		gpa_t shmem;
+		u64 last_steal;
+	} sta;
+
 	/* VCPU power-off state */
 	bool power_off;
 
@@ -48,5 +48,6 @@ void kvm_riscv_guest_timer_init(struct kvm *kvm);
 void kvm_riscv_vcpu_timer_sync(struct kvm_vcpu *vcpu);
 void kvm_riscv_vcpu_timer_save(struct kvm_vcpu *vcpu);
 bool kvm_riscv_vcpu_timer_pending(struct kvm_vcpu *vcpu);
+void kvm_riscv_vcpu_timer_halt_poll(struct kvm_vcpu *vcpu);
 
 #endif
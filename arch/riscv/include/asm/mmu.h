@@ -16,6 +16,8 @@ typedef struct {
 	atomic_long_t id;
 #endif
 	void *vdso;
+	/* Misaligned access traps taken by all threads of the process */
+	atomic_long_t misaligned_count;
 #ifdef CONFIG_SMP
 	/* A local icache flush is needed before user execution can resume. */
 	cpumask_t icache_stale_mask;
@@ -30,6 +30,7 @@ static inline int init_new_context(struct task_struct *tsk,
 #ifdef CONFIG_MMU
 	atomic_long_set(&mm->context.id, 0);
 #endif
+	atomic_long_set(&mm->context.misaligned_count, 0);
 	return 0;
 }
 
@@ -0,0 +1 @@
+#include <asm/paravirt.h>
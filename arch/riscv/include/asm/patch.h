@@ -6,8 +6,16 @@
 #ifndef _ASM_RISCV_PATCH_H
 #define _ASM_RISCV_PATCH_H
 
+struct riscv_patch_site {
+	void *addr;
+	u32 insn;
+};
+
+int patch_insn_write(void *addr, const void *insn, size_t len);
 int patch_text_nosync(void *addr, const void *insns, size_t len);
 int patch_text(void *addr, u32 insn);
+int patch_text_batch(const struct riscv_patch_site *sites, unsigned int nr);
+int patch_text_stop_machine(int (*fn)(void *data), void *data);
 
 extern int riscv_patch_in_stop_machine;
 
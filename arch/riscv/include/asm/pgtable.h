@@ -121,6 +121,7 @@
 
 #ifndef __ASSEMBLY__
 
+#include <asm/hwcap.h>
 #include <asm/page.h>
 #include <asm/tlbflush.h>
 #include <linux/mm_types.h>
@@ -280,10 +281,48 @@ static inline pte_t pud_pte(pud_t pud)
 	return __pte(pud_val(pud));
 }
 
+/* Svnapot only exists for RV64; whether the harts have it is probed at boot */
+#ifdef CONFIG_64BIT
+static __always_inline bool has_svnapot(void)
+{
+	return static_branch_unlikely(&riscv_isa_ext_keys[RISCV_ISA_EXT_KEY_SVNAPOT]);
+}
+
+static inline unsigned long pte_napot(pte_t pte)
+{
+	return pte_val(pte) & _PAGE_NAPOT;
+}
+
+/*
+ * A NAPOT pte of order N encodes the size in the low bits of its PFN: bit
+ * N - 1 is set and the bits below it are clear.
+ */
+static inline pte_t pte_mknapot(pte_t pte, unsigned int order)
+{
+	int pos = order - 1 + _PAGE_PFN_SHIFT;
+	unsigned long napot_bit = BIT(pos);
+	unsigned long napot_mask = ~GENMASK(pos, _PAGE_PFN_SHIFT);
+
+	return __pte((pte_val(pte) & napot_mask) | napot_bit | _PAGE_NAPOT);
+}
+#else
+static __always_inline bool has_svnapot(void) { return false; }
+
+static inline unsigned long pte_napot(pte_t pte)
+{
+	return 0;
+}
+#endif /* CONFIG_64BIT */
+
 /* Yields the page frame number (PFN) of a page table entry */
 static inline unsigned long pte_pfn(pte_t pte)
 {
-	return __page_val_to_pfn(pte_val(pte));
+	unsigned long res = __page_val_to_pfn(pte_val(pte));
+
+	if (has_svnapot() && pte_napot(pte))
+		res = res & (res - 1UL);
+
+	return res;
 }
 
 #define pte_page(x)     pfn_to_page(pte_pfn(x))
@@ -479,6 +518,33 @@ static inline void set_pte_at(struct mm_struct *mm,
 	__set_pte_at(mm, addr, ptep, pteval);
 }
 
+#define pte_next_pfn pte_next_pfn
+static inline pte_t pte_next_pfn(pte_t pte)
+{
+	return __pte(pte_val(pte) + (1UL << _PAGE_PFN_SHIFT));
+}
+
+void flush_icache_ptes(pte_t pte, unsigned int nr);
+
+/* Like set_pte_at(), with one icache flush for the whole range */
+#define set_ptes set_ptes
+static inline void set_ptes(struct mm_struct *mm, unsigned long addr,
+	pte_t *ptep, pte_t pteval, unsigned int nr)
+{
+	if (pte_present(pteval) && pte_exec(pteval))
+		flush_icache_ptes(pteval, nr);
+
+	for (;;) {
+		page_table_check_pte_set(mm, addr, ptep, pteval);
+		set_pte(ptep, pteval);
+		if (--nr == 0)
+			break;
+		ptep++;
+		addr += PAGE_SIZE;
+		pteval = pte_next_pfn(pteval);
+	}
+}
+
 static inline void pte_clear(struct mm_struct *mm,
 	unsigned long addr, pte_t *ptep)
 {
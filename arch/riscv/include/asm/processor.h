@@ -31,6 +31,16 @@
 struct task_struct;
 struct pt_regs;
 
+/* Per-task vector context switch accounting, see /proc/<pid>/status */
+struct riscv_vstate_stats {
+	unsigned long saves;		/* dirty state written back */
+	unsigned long saves_skipped;	/* clean state, nothing written */
+	unsigned long restores;		/* state loaded from memory */
+	unsigned long restores_skipped;	/* state still live on the CPU */
+	unsigned long parks;		/* access dropped after idling */
+	unsigned long unparks;		/* access regained by trapping */
+};
+
 /* CPU-specific state of a task */
 struct thread_struct {
 	/* Callee-saved registers */
@@ -40,6 +50,15 @@ struct thread_struct {
 	struct __riscv_d_ext_state fstate;
 	unsigned long bad_cause;
 	struct __riscv_v_state vstate;
+#ifdef CONFIG_VECTOR
+	unsigned int vstate_cpu;	/* CPU the state was last live on */
+	unsigned int vstate_idle;	/* switches since the state was dirty */
+	bool vstate_parked;		/* state in memory, access dropped */
+	struct riscv_vstate_stats vstat;
+#endif
+	unsigned long align_ctl;	/* PR_SET_UNALIGN */
+	unsigned long misaligned_loads;
+	unsigned long misaligned_stores;
 };
 
 /* Whitelist the fstate from the task_struct for hardened usercopy */
@@ -68,6 +87,12 @@ extern void start_thread(struct pt_regs *regs,
 
 extern unsigned long __get_wchan(struct task_struct *p);
 
+extern int riscv_set_unalign_ctl(struct task_struct *tsk, unsigned int val);
+extern int riscv_get_unalign_ctl(struct task_struct *tsk, unsigned long addr);
+
+#define SET_UNALIGN_CTL(tsk, val)	riscv_set_unalign_ctl((tsk), (val))
+#define GET_UNALIGN_CTL(tsk, addr)	riscv_get_unalign_ctl((tsk), (addr))
+
 
 static inline void wait_for_interrupt(void)
 {
@@ -30,11 +30,15 @@ enum sbi_ext_id {
 	SBI_EXT_HSM = 0x48534D,
 	SBI_EXT_SRST = 0x53525354,
 	SBI_EXT_PMU = 0x504D55,
+	SBI_EXT_STA = 0x535441,
 
 	/* Experimentals extensions must lie within this range */
 	SBI_EXT_EXPERIMENTAL_START = 0x08000000,
 	SBI_EXT_EXPERIMENTAL_END = 0x08FFFFFF,
 
+	/* KVM paravirtual directed yield */
+	SBI_EXT_PV_YIELD = 0x08505659,
+
 	/* Vendor extensions must lie within this range */
 	SBI_EXT_VENDOR_START = 0x09000000,
 	SBI_EXT_VENDOR_END = 0x09FFFFFF,
@@ -113,6 +117,28 @@ enum sbi_srst_reset_reason {
 	SBI_SRST_RESET_REASON_SYS_FAILURE,
 };
 
+enum sbi_ext_sta_fid {
+	SBI_EXT_STA_STEAL_TIME_SET_SHMEM = 0,
+};
+
+/* Per-hart steal-time record shared between the SBI implementation and S-mode */
+struct sbi_sta_struct {
+	__le32 sequence;
+	__le32 flags;
+	__le64 steal;
+	u8 preempted;
+	u8 pad[47];
+} __packed;
+
+#define SBI_SHMEM_DISABLE		-1
+
+enum sbi_ext_pv_yield_fid {
+	SBI_EXT_PV_YIELD_TO = 0,
+};
+
+/* Let the SBI implementation pick a preempted hart of its choice */
+#define SBI_PV_YIELD_ANY		-1UL
+
 enum sbi_ext_pmu_fid {
 	SBI_EXT_PMU_NUM_COUNTERS = 0,
 	SBI_EXT_PMU_COUNTER_GET_INFO,
@@ -8,6 +8,7 @@
 
 #include <linux/cpumask.h>
 #include <linux/irqreturn.h>
+#include <linux/jump_label.h>
 #include <linux/thread_info.h>
 
 #define INVALID_HARTID ULONG_MAX
@@ -15,9 +16,18 @@
 struct seq_file;
 extern unsigned long boot_cpu_hartid;
 
+/* Mechanisms used to carry a remote TLB or icache fence to other harts */
+enum riscv_rfence_path {
+	RISCV_RFENCE_SBI,
+	RISCV_RFENCE_IPI,
+	RISCV_RFENCE_MAX
+};
+
 struct riscv_ipi_ops {
 	void (*ipi_inject)(const struct cpumask *target);
 	void (*ipi_clear)(void);
+	/* IPIs are raised directly from S-mode, without an SBI call */
+	bool use_for_rfence;
 };
 
 #ifdef CONFIG_SMP
@@ -50,6 +60,14 @@ void riscv_set_ipi_ops(const struct riscv_ipi_ops *ops);
 /* Clear IPI for current CPU */
 void riscv_clear_ipi(void);
 
+/* Check if IPI based remote fences can be used instead of SBI */
+DECLARE_STATIC_KEY_FALSE(riscv_ipi_for_rfence);
+#define riscv_use_ipi_for_rfence() \
+	static_branch_unlikely(&riscv_ipi_for_rfence)
+
+/* Account a remote fence started at @start_ns (local_clock()) to @path */
+void riscv_rfence_account(enum riscv_rfence_path path, u64 start_ns);
+
 /* Check other CPUs stop or not */
 bool smp_crash_stop_failed(void);
 
@@ -93,6 +111,16 @@ static inline void riscv_clear_ipi(void)
 {
 }
 
+static inline bool riscv_use_ipi_for_rfence(void)
+{
+	return false;
+}
+
+static inline void riscv_rfence_account(enum riscv_rfence_path path,
+					u64 start_ns)
+{
+}
+
 #endif /* CONFIG_SMP */
 
 #if defined(CONFIG_HOTPLUG_CPU) && (CONFIG_SMP)
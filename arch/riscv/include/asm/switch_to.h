@@ -7,12 +7,16 @@
 #define _ASM_RISCV_SWITCH_TO_H
 
 #include <linux/jump_label.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
 #include <linux/sched/task_stack.h>
 #include <asm/hwcap.h>
 #include <asm/processor.h>
 #include <asm/ptrace.h>
 #include <asm/csr.h>
 
+struct seq_file;
+
 #ifdef CONFIG_FPU
 extern void __fstate_save(struct task_struct *save_to);
 extern void __fstate_restore(struct task_struct *restore_from);
@@ -86,9 +90,47 @@ static __always_inline bool has_fpu(void) { return false; }
 extern void __vstate_save(struct task_struct *save_to);
 extern void __vstate_restore(struct task_struct *restore_from);
 
+/*
+ * Task whose vector state was last loaded into (or saved from) this CPU's
+ * registers. Together with thread.vstate_cpu it lets a task switched back
+ * in on the same CPU skip the reload when nobody touched the unit since.
+ */
+DECLARE_PER_CPU(struct task_struct *, vstate_last_owner);
+
+/* Called with preemption disabled, like everything touching the registers */
+static inline void vstate_set_owner(struct task_struct *task)
+{
+	__this_cpu_write(vstate_last_owner, task);
+	task->thread.vstate_cpu = smp_processor_id();
+}
+
+/* Forget which task's state the live registers hold */
+static inline void vstate_invalidate_cpu(void)
+{
+	__this_cpu_write(vstate_last_owner, NULL);
+}
+
+/* Force a reload of @task's state from memory on its next switch-in */
+static inline void vstate_invalidate_task(struct task_struct *task)
+{
+	task->thread.vstate_cpu = NR_CPUS;
+}
+
+static inline bool vstate_is_live(struct task_struct *task)
+{
+	return __this_cpu_read(vstate_last_owner) == task &&
+	       task->thread.vstate_cpu == smp_processor_id();
+}
+
 static inline void __vstate_clean(struct pt_regs *regs)
 {
-	regs->status |= (regs->status & ~(SR_VS)) | SR_VS_CLEAN;
+	regs->status = (regs->status & ~SR_VS) | SR_VS_CLEAN;
+}
+
+static inline void vstate_off(struct task_struct *task,
+			      struct pt_regs *regs)
+{
+	regs->status = (regs->status & ~SR_VS) | SR_VS_OFF;
 }
 
 static inline void vstate_save(struct task_struct *task,
@@ -97,6 +139,7 @@ static inline void vstate_save(struct task_struct *task,
 	if ((regs->status & SR_VS) == SR_VS_DIRTY) {
 		__vstate_save(task);
 		__vstate_clean(regs);
+		task->thread.vstat.saves++;
 	}
 }
 
@@ -106,20 +149,41 @@ static inline void vstate_restore(struct task_struct *task,
 	if ((regs->status & SR_VS) != SR_VS_OFF) {
 		__vstate_restore(task);
 		__vstate_clean(regs);
+		vstate_set_owner(task);
+		task->thread.vstat.restores++;
 	}
 }
 
+void vstate_switch_out(struct task_struct *task, struct pt_regs *regs);
+
+static inline void vstate_switch_in(struct task_struct *task,
+				    struct pt_regs *regs)
+{
+	if ((regs->status & SR_VS) == SR_VS_OFF)
+		return;
+
+	if (vstate_is_live(task)) {
+		task->thread.vstat.restores_skipped++;
+		return;
+	}
+
+	vstate_restore(task, regs);
+}
+
 static inline void __switch_to_vector(struct task_struct *prev,
 		struct task_struct *next)
 {
 	struct pt_regs *regs;
 
 	regs = task_pt_regs(prev);
-	if (unlikely(regs->status & SR_SD))
-		vstate_save(prev, regs);
-	vstate_restore(next, task_pt_regs(next));
+	if ((regs->status & SR_VS) != SR_VS_OFF)
+		vstate_switch_out(prev, regs);
+	vstate_switch_in(next, task_pt_regs(next));
 }
 
+bool vstate_unpark(struct task_struct *task, struct pt_regs *regs);
+void vstate_proc_show(struct seq_file *m, struct task_struct *task);
+
 extern struct static_key_false cpu_hwcap_vector;
 static __always_inline bool has_vector(void)
 {
@@ -130,6 +194,13 @@ static __always_inline bool has_vector(void) { return false; }
 #define vstate_save(task, regs) do { } while (0)
 #define vstate_restore(task, regs) do { } while (0)
 #define __switch_to_vector(__prev, __next) do { } while (0)
+static inline bool vstate_unpark(struct task_struct *task,
+				 struct pt_regs *regs)
+{
+	return false;
+}
+static inline void vstate_proc_show(struct seq_file *m,
+				    struct task_struct *task) { }
 #endif
 
 extern struct task_struct *__switch_to(struct task_struct *,
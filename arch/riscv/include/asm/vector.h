@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Kernel mode use of the vector unit
+ */
+
+#ifndef _ASM_RISCV_VECTOR_H
+#define _ASM_RISCV_VECTOR_H
+
+#include <asm/switch_to.h>
+
+#ifdef CONFIG_VECTOR
+
+/*
+ * Vector code in the kernel must be bracketed by kernel_vector_begin()
+ * and kernel_vector_end(), and may only run where may_use_simd() allows
+ * it. The sections are neither preemptible nor reentrant from softirq.
+ */
+void kernel_vector_begin(void);
+void kernel_vector_end(void);
+
+#else
+
+static inline void kernel_vector_begin(void) { BUILD_BUG(); }
+static inline void kernel_vector_end(void) { BUILD_BUG(); }
+
+#endif /* CONFIG_VECTOR */
+
+#endif /* _ASM_RISCV_VECTOR_H */
@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <linux/hardirq.h>
+#include <asm-generic/xor.h>
+#include <asm/simd.h>
+#include <asm/vector.h>
+
+#ifdef CONFIG_VECTOR
+
+extern struct xor_block_template const xor_block_inner_rvv;
+
+/*
+ * xor_blocks() may be reached from softirq context while another vector
+ * section is live on this CPU, so fall back to the integer code then.
+ */
+static void
+xor_rvv_2(unsigned long bytes, unsigned long * __restrict p1,
+	  const unsigned long * __restrict p2)
+{
+	if (!may_use_simd()) {
+		xor_32regs_2(bytes, p1, p2);
+		return;
+	}
+
+	kernel_vector_begin();
+	xor_block_inner_rvv.do_2(bytes, p1, p2);
+	kernel_vector_end();
+}
+
+static void
+xor_rvv_3(unsigned long bytes, unsigned long * __restrict p1,
+	  const unsigned long * __restrict p2,
+	  const unsigned long * __restrict p3)
+{
+	if (!may_use_simd()) {
+		xor_32regs_3(bytes, p1, p2, p3);
+		return;
+	}
+
+	kernel_vector_begin();
+	xor_block_inner_rvv.do_3(bytes, p1, p2, p3);
+	kernel_vector_end();
+}
+
+static void
+xor_rvv_4(unsigned long bytes, unsigned long * __restrict p1,
+	  const unsigned long * __restrict p2,
+	  const unsigned long * __restrict p3,
+	  const unsigned long * __restrict p4)
+{
+	if (!may_use_simd()) {
+		xor_32regs_4(bytes, p1, p2, p3, p4);
+		return;
+	}
+
+	kernel_vector_begin();
+	xor_block_inner_rvv.do_4(bytes, p1, p2, p3, p4);
+	kernel_vector_end();
+}
+
+static void
+xor_rvv_5(unsigned long bytes, unsigned long * __restrict p1,
+	  const unsigned long * __restrict p2,
+	  const unsigned long * __restrict p3,
+	  const unsigned long * __restrict p4,
+	  const unsigned long * __restrict p5)
+{
+	if (!may_use_simd()) {
+		xor_32regs_5(bytes, p1, p2, p3, p4, p5);
+		return;
+	}
+
+	kernel_vector_begin();
+	xor_block_inner_rvv.do_5(bytes, p1, p2, p3, p4, p5);
+	kernel_vector_end();
+}
+
+static struct xor_block_template xor_block_rvv = {
+	.name	= "rvv",
+	.do_2	= xor_rvv_2,
+	.do_3	= xor_rvv_3,
+	.do_4	= xor_rvv_4,
+	.do_5	= xor_rvv_5
+};
+
+#undef XOR_TRY_TEMPLATES
+#define XOR_TRY_TEMPLATES			\
+	do {					\
+		xor_speed(&xor_block_8regs);	\
+		xor_speed(&xor_block_32regs);	\
+		if (has_vector())		\
+			xor_speed(&xor_block_rvv);\
+	} while (0)
+
+#endif /* CONFIG_VECTOR */
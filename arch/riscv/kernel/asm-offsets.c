@@ -13,6 +13,7 @@
 #include <asm/thread_info.h>
 #include <asm/ptrace.h>
 #include <asm/cpu_ops_sbi.h>
+#include <asm/sbi.h>
 #include <asm/suspend.h>
 
 void asm_offsets(void);
@@ -663,4 +664,8 @@ void asm_offsets(void)
 	OFFSET(KERNEL_MAP_VIRT_ADDR, kernel_mapping, virt_addr);
 	OFFSET(SBI_HART_BOOT_TASK_PTR_OFFSET, sbi_hart_boot_data, task_ptr);
 	OFFSET(SBI_HART_BOOT_STACK_PTR_OFFSET, sbi_hart_boot_data, stack_ptr);
+#ifdef CONFIG_RISCV_SBI
+	DEFINE(SBI_HSM_EXT_ID, SBI_EXT_HSM);
+	DEFINE(SBI_HSM_HART_STOP_FID, SBI_EXT_HSM_HART_STOP);
+#endif
 }
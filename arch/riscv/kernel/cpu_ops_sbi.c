@@ -5,6 +5,7 @@
  * Copyright (c) 2020 Western Digital Corporation or its affiliates.
  */
 
+#include <linux/delay.h>
 #include <linux/init.h>
 #include <linux/mm.h>
 #include <linux/sched/task_stack.h>
@@ -23,6 +24,9 @@ const struct cpu_operations cpu_ops_sbi;
  */
 static DEFINE_PER_CPU(struct sbi_hart_boot_data, boot_data);
 
+/* Harts started early that are waiting in secondary_start_sbi */
+static struct cpumask prestarted_cpus;
+
 static int sbi_hsm_hart_start(unsigned long hartid, unsigned long saddr,
 			      unsigned long priv)
 {
@@ -48,6 +52,7 @@ static int sbi_hsm_hart_stop(void)
 	else
 		return 0;
 }
+#endif
 
 static int sbi_hsm_hart_get_status(unsigned long hartid)
 {
@@ -60,7 +65,50 @@ static int sbi_hsm_hart_get_status(unsigned long hartid)
 	else
 		return ret.value;
 }
-#endif
+
+static int sbi_cpu_prestart(unsigned int cpuid)
+{
+	unsigned long boot_addr = __pa_symbol(secondary_start_sbi);
+	unsigned long hartid = cpuid_to_hartid_map(cpuid);
+	struct sbi_hart_boot_data *bdata = &per_cpu(boot_data, cpuid);
+	int ret;
+
+	/* The hart spins in secondary_start_sbi until both are set */
+	WRITE_ONCE(bdata->task_ptr, NULL);
+	WRITE_ONCE(bdata->stack_ptr, NULL);
+	smp_mb();
+
+	ret = sbi_hsm_hart_start(hartid, boot_addr, __pa(bdata));
+	if (!ret)
+		cpumask_set_cpu(cpuid, &prestarted_cpus);
+
+	return ret;
+}
+
+static void sbi_cpu_prestart_cancel(unsigned int cpuid)
+{
+	unsigned long hartid = cpuid_to_hartid_map(cpuid);
+	struct sbi_hart_boot_data *bdata = &per_cpu(boot_data, cpuid);
+	int i, rc;
+
+	if (!cpumask_test_and_clear_cpu(cpuid, &prestarted_cpus))
+		return;
+
+	/* secondary_start_sbi stops the hart once it sees this */
+	WRITE_ONCE(bdata->task_ptr, (void *)SBI_HART_BOOT_STOP);
+	smp_mb();
+
+	/* Wait for it, so that a later cpu_start can restart the hart */
+	for (i = 0; i < 1000; i++) {
+		rc = sbi_hsm_hart_get_status(hartid);
+		if (rc == SBI_HSM_STATE_STOPPED)
+			return;
+		udelay(100);
+	}
+
+	pr_warn("CPU%u: prestarted hart %lu did not stop (%d)\n",
+		cpuid, hartid, rc);
+}
 
 static int sbi_cpu_start(unsigned int cpuid, struct task_struct *tidle)
 {
@@ -71,10 +119,15 @@ static int sbi_cpu_start(unsigned int cpuid, struct task_struct *tidle)
 
 	/* Make sure tidle is updated */
 	smp_mb();
-	bdata->task_ptr = tidle;
-	bdata->stack_ptr = task_stack_page(tidle) + THREAD_SIZE;
+	WRITE_ONCE(bdata->task_ptr, tidle);
+	WRITE_ONCE(bdata->stack_ptr, task_stack_page(tidle) + THREAD_SIZE);
 	/* Make sure boot data is updated */
 	smp_mb();
+
+	/* A prestarted hart is already running and picks up the data */
+	if (cpumask_test_and_clear_cpu(cpuid, &prestarted_cpus))
+		return 0;
+
 	hsm_data = __pa(bdata);
 	return sbi_hsm_hart_start(hartid, boot_addr, hsm_data);
 }
@@ -120,6 +173,8 @@ static int sbi_cpu_is_stopped(unsigned int cpuid)
 const struct cpu_operations cpu_ops_sbi = {
 	.name		= "sbi",
 	.cpu_prepare	= sbi_cpu_prepare,
+	.cpu_prestart	= sbi_cpu_prestart,
+	.cpu_prestart_cancel = sbi_cpu_prestart_cancel,
 	.cpu_start	= sbi_cpu_start,
 #ifdef CONFIG_HOTPLUG_CPU
 	.cpu_disable	= sbi_cpu_disable,
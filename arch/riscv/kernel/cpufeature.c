@@ -36,6 +36,7 @@ EXPORT_SYMBOL(riscv_isa_ext_keys);
 
 #ifdef CONFIG_VECTOR
 __ro_after_init DEFINE_STATIC_KEY_FALSE(cpu_hwcap_vector);
+EXPORT_SYMBOL(cpu_hwcap_vector);
 
 static int __init do_hide_v0p7_ext(char *str)
 {
@@ -222,6 +223,7 @@ void __init riscv_fill_hwcap(void)
 				SET_ISA_EXT_MAP("zihintpause", RISCV_ISA_EXT_ZIHINTPAUSE);
 				SET_ISA_EXT_MAP("sstc", RISCV_ISA_EXT_SSTC);
 				SET_ISA_EXT_MAP("svinval", RISCV_ISA_EXT_SVINVAL);
+				SET_ISA_EXT_MAP("svnapot", RISCV_ISA_EXT_SVNAPOT);
 			}
 #undef SET_ISA_EXT_MAP
 		}
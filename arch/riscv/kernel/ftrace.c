@@ -5,6 +5,7 @@
  * Copyright (C) 2017 Andes Technology Corporation
  */
 
+#include <linux/cpu.h>
 #include <linux/ftrace.h>
 #include <linux/uaccess.h>
 #include <linux/memory.h>
@@ -31,6 +32,39 @@ void ftrace_arch_code_modify_post_process(void) __releases(&text_mutex)
 	mutex_unlock(&text_mutex);
 }
 
+/* Set while arch_ftrace_update_code() has all the other CPUs parked */
+static bool ftrace_patch_batched;
+
+/*
+ * Inside arch_ftrace_update_code() every CPU issues a local fence.i once
+ * all the call sites are written, so skip the per-site icache flush there.
+ */
+static int ftrace_patch_text(unsigned long addr, const void *insns)
+{
+	if (ftrace_patch_batched)
+		return patch_insn_write((void *)addr, insns, MCOUNT_INSN_SIZE);
+
+	return patch_text_nosync((void *)addr, insns, MCOUNT_INSN_SIZE);
+}
+
+static int __ftrace_modify_code(void *data)
+{
+	int *command = data;
+
+	ftrace_patch_batched = true;
+	ftrace_modify_all_code(*command);
+	ftrace_patch_batched = false;
+
+	return 0;
+}
+
+void arch_ftrace_update_code(int command)
+{
+	cpus_read_lock();
+	patch_text_stop_machine(__ftrace_modify_code, &command);
+	cpus_read_unlock();
+}
+
 static int ftrace_check_current_call(unsigned long hook_pos,
 				     unsigned int *expected)
 {
@@ -75,8 +109,7 @@ static int __ftrace_modify_call(unsigned long hook_pos, unsigned long target,
 		make_call_t0(hook_pos, target, call);
 
 	/* Replace the auipc-jalr pair at once. Return -EPERM on write error. */
-	if (patch_text_nosync
-	    ((void *)hook_pos, enable ? call : nops, MCOUNT_INSN_SIZE))
+	if (ftrace_patch_text(hook_pos, enable ? call : nops))
 		return -EPERM;
 
 	return 0;
@@ -88,7 +121,7 @@ int ftrace_make_call(struct dyn_ftrace *rec, unsigned long addr)
 
 	make_call_t0(rec->ip, addr, call);
 
-	if (patch_text_nosync((void *)rec->ip, call, MCOUNT_INSN_SIZE))
+	if (ftrace_patch_text(rec->ip, call))
 		return -EPERM;
 
 	return 0;
@@ -99,7 +132,7 @@ int ftrace_make_nop(struct module *mod, struct dyn_ftrace *rec,
 {
 	unsigned int nops[2] = {NOP4, NOP4};
 
-	if (patch_text_nosync((void *)rec->ip, nops, MCOUNT_INSN_SIZE))
+	if (ftrace_patch_text(rec->ip, nops))
 		return -EPERM;
 
 	return 0;
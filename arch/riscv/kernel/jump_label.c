@@ -9,33 +9,78 @@
 #include <linux/memory.h>
 #include <linux/mutex.h>
 #include <asm/bug.h>
+#include <asm/cacheflush.h>
 #include <asm/patch.h>
 
 #define RISCV_INSN_NOP 0x00000013U
 #define RISCV_INSN_JAL 0x0000006fU
 
-void arch_jump_label_transform(struct jump_entry *entry,
-			       enum jump_label_type type)
-{
-	void *addr = (void *)jump_entry_code(entry);
-	u32 insn;
+/* Sites written by arch_jump_label_transform_queue() since the last flush */
+static unsigned int jump_label_queued;
 
+static bool jump_label_make_insn(struct jump_entry *entry,
+				 enum jump_label_type type, u32 *insn)
+{
 	if (type == JUMP_LABEL_JMP) {
 		long offset = jump_entry_target(entry) - jump_entry_code(entry);
 
 		if (WARN_ON(offset & 1 || offset < -524288 || offset >= 524288))
-			return;
+			return false;
 
-		insn = RISCV_INSN_JAL |
+		*insn = RISCV_INSN_JAL |
 			(((u32)offset & GENMASK(19, 12)) << (12 - 12)) |
 			(((u32)offset & GENMASK(11, 11)) << (20 - 11)) |
 			(((u32)offset & GENMASK(10,  1)) << (21 -  1)) |
 			(((u32)offset & GENMASK(20, 20)) << (31 - 20));
 	} else {
-		insn = RISCV_INSN_NOP;
+		*insn = RISCV_INSN_NOP;
 	}
 
+	return true;
+}
+
+void arch_jump_label_transform(struct jump_entry *entry,
+			       enum jump_label_type type)
+{
+	void *addr = (void *)jump_entry_code(entry);
+	u32 insn;
+
+	if (!jump_label_make_insn(entry, type, &insn))
+		return;
+
 	mutex_lock(&text_mutex);
 	patch_text_nosync(addr, &insn, sizeof(insn));
 	mutex_unlock(&text_mutex);
 }
+
+/*
+ * A site is a single aligned 32-bit instruction and both its old and new
+ * versions are valid, so it can be rewritten in place without stopping the
+ * other harts. Only the icache maintenance is deferred: one global flush
+ * covers every site of the key instead of one per site.
+ */
+bool arch_jump_label_transform_queue(struct jump_entry *entry,
+				     enum jump_label_type type)
+{
+	void *addr = (void *)jump_entry_code(entry);
+	u32 insn;
+
+	if (!jump_label_make_insn(entry, type, &insn))
+		return true;
+
+	mutex_lock(&text_mutex);
+	patch_insn_write(addr, &insn, sizeof(insn));
+	mutex_unlock(&text_mutex);
+	jump_label_queued++;
+
+	return true;
+}
+
+void arch_jump_label_transform_apply(void)
+{
+	if (!jump_label_queued)
+		return;
+
+	flush_icache_all();
+	jump_label_queued = 0;
+}
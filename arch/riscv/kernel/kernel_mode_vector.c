@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Kernel mode use of the vector unit
+ *
+ * Based on arch/arm64/kernel/fpsimd.c
+ */
+
+#include <linux/bottom_half.h>
+#include <linux/bug.h>
+#include <linux/export.h>
+#include <linux/percpu.h>
+#include <linux/preempt.h>
+#include <linux/sched.h>
+
+#include <asm/csr.h>
+#include <asm/simd.h>
+#include <asm/switch_to.h>
+#include <asm/vector.h>
+
+DEFINE_PER_CPU(bool, vector_context_busy);
+EXPORT_PER_CPU_SYMBOL(vector_context_busy);
+
+/*
+ * Claim ownership of the CPU vector context for use by the calling context.
+ *
+ * The caller may freely manipulate the vector context metadata until
+ * put_cpu_vector_context() is called.
+ *
+ * The kernel may use vector in softirq context, so bottom halves are
+ * disabled as well as preemption; a softirq that finds the context busy
+ * sees may_use_simd() return false and must use a scalar fallback.
+ */
+static void get_cpu_vector_context(void)
+{
+	local_bh_disable();
+
+	WARN_ON(__this_cpu_read(vector_context_busy));
+	__this_cpu_write(vector_context_busy, true);
+}
+
+/*
+ * Release the CPU vector context.
+ *
+ * Must be called from a context in which get_cpu_vector_context() was
+ * previously called, with no call to put_cpu_vector_context() in the
+ * meantime.
+ */
+static void put_cpu_vector_context(void)
+{
+	WARN_ON(!__this_cpu_read(vector_context_busy));
+	__this_cpu_write(vector_context_busy, false);
+
+	local_bh_enable();
+}
+
+/*
+ * kernel_vector_begin(): obtain the CPU vector registers for use by the
+ * calling context
+ *
+ * Must not be called unless may_use_simd() returns true.
+ * Task context in the vector registers is saved back to memory as
+ * necessary; nothing is written back if the user state is not dirty.
+ *
+ * A matching call to kernel_vector_end() must be made before returning
+ * from the calling context.
+ */
+void kernel_vector_begin(void)
+{
+	if (WARN_ON(!has_vector()))
+		return;
+
+	BUG_ON(!may_use_simd());
+
+	get_cpu_vector_context();
+
+	vstate_save(current, task_pt_regs(current));
+	vstate_invalidate_cpu();
+
+	csr_set(CSR_SSTATUS, SR_VS);
+}
+EXPORT_SYMBOL_GPL(kernel_vector_begin);
+
+/*
+ * kernel_vector_end(): give the CPU vector registers back to the current
+ * task
+ *
+ * Must be called from a context in which kernel_vector_begin() was
+ * previously called, with no call to kernel_vector_end() in the meantime.
+ */
+void kernel_vector_end(void)
+{
+	if (WARN_ON(!has_vector()))
+		return;
+
+	csr_clear(CSR_SSTATUS, SR_VS);
+
+	vstate_restore(current, task_pt_regs(current));
+
+	put_cpu_vector_context();
+}
+EXPORT_SYMBOL_GPL(kernel_vector_end);
@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Steal-time accounting and spin yielding for guests running on an SBI
+ * implementation that provides the STA and PV yield extensions.
+ */
+
+#define pr_fmt(fmt) "riscv-pv: " fmt
+
+#include <linux/cpuhotplug.h>
+#include <linux/export.h>
+#include <linux/jump_label.h>
+#include <linux/percpu-defs.h>
+#include <linux/printk.h>
+#include <linux/spinlock.h>
+#include <linux/static_call.h>
+#include <linux/types.h>
+
+#include <asm/barrier.h>
+#include <asm/paravirt.h>
+#include <asm/sbi.h>
+#include <asm/smp.h>
+
+struct static_key paravirt_steal_enabled;
+struct static_key paravirt_steal_rq_enabled;
+
+static u64 native_steal_clock(int cpu)
+{
+	return 0;
+}
+
+DEFINE_STATIC_CALL(pv_steal_clock, native_steal_clock);
+
+static bool steal_acc = true;
+static int __init parse_no_stealacc(char *arg)
+{
+	steal_acc = false;
+	return 0;
+}
+
+early_param("no-steal-acc", parse_no_stealacc);
+
+static DEFINE_PER_CPU(struct sbi_sta_struct, steal_time) __aligned(64);
+
+static DEFINE_STATIC_KEY_FALSE(pv_yield_enabled);
+
+static int sbi_sta_steal_time_set_shmem(unsigned long lo, unsigned long hi,
+					unsigned long flags)
+{
+	struct sbiret ret;
+
+	ret = sbi_ecall(SBI_EXT_STA, SBI_EXT_STA_STEAL_TIME_SET_SHMEM,
+			lo, hi, flags, 0, 0, 0);
+	if (ret.error) {
+		if (lo == SBI_SHMEM_DISABLE && hi == SBI_SHMEM_DISABLE)
+			pr_warn("Failed to disable steal-time shmem");
+		else
+			pr_warn("Failed to set steal-time shmem");
+		return sbi_err_map_linux_errno(ret.error);
+	}
+
+	return 0;
+}
+
+static int pv_time_cpu_online(unsigned int cpu)
+{
+	struct sbi_sta_struct *st = this_cpu_ptr(&steal_time);
+	phys_addr_t pa = __pa(st);
+	unsigned long lo = (unsigned long)pa;
+	unsigned long hi = IS_ENABLED(CONFIG_32BIT) ? upper_32_bits((u64)pa) : 0;
+
+	return sbi_sta_steal_time_set_shmem(lo, hi, 0);
+}
+
+static int pv_time_cpu_down_prepare(unsigned int cpu)
+{
+	return sbi_sta_steal_time_set_shmem(SBI_SHMEM_DISABLE,
+					    SBI_SHMEM_DISABLE, 0);
+}
+
+/* Retry while the hypervisor is in the middle of an update */
+static u64 pv_time_steal_clock(int cpu)
+{
+	struct sbi_sta_struct *st = per_cpu_ptr(&steal_time, cpu);
+	__le32 sequence;
+	__le64 steal;
+
+	do {
+		sequence = READ_ONCE(st->sequence);
+		virt_rmb();
+		steal = READ_ONCE(st->steal);
+		virt_rmb();
+	} while ((le32_to_cpu(sequence) & 1) ||
+		 sequence != READ_ONCE(st->sequence));
+
+	return le64_to_cpu(steal);
+}
+
+bool pv_vcpu_is_preempted(int cpu)
+{
+	return READ_ONCE(per_cpu(steal_time, cpu).preempted);
+}
+EXPORT_SYMBOL(pv_vcpu_is_preempted);
+
+/*
+ * Donate the rest of our time slice, either to @cpu or, if it is negative,
+ * to whichever preempted vCPU of this guest the hypervisor picks.
+ */
+void pv_yield_to_cpu(int cpu)
+{
+	unsigned long hartid;
+
+	if (!static_branch_unlikely(&pv_yield_enabled))
+		return;
+
+	hartid = cpu < 0 ? SBI_PV_YIELD_ANY : cpuid_to_hartid_map(cpu);
+	sbi_ecall(SBI_EXT_PV_YIELD, SBI_EXT_PV_YIELD_TO, hartid,
+		  0, 0, 0, 0, 0);
+}
+EXPORT_SYMBOL(pv_yield_to_cpu);
+
+#ifdef CONFIG_PARAVIRT_SPINLOCKS
+/* Spins between yield hints on a contended ticket lock */
+#define PV_SPIN_THRESHOLD	(1 << 10)
+
+void pv_ticket_lock_wait(arch_spinlock_t *lock, u16 ticket)
+{
+	unsigned int loops = 0;
+
+	while (ticket != (u16)atomic_read_acquire(lock)) {
+		/*
+		 * The ticket lock does not record its owner, so let the
+		 * hypervisor run a preempted vCPU of ours in the hope that
+		 * it is the holder or one of the waiters ahead of us.
+		 */
+		if (++loops == PV_SPIN_THRESHOLD) {
+			pv_yield_to_cpu(-1);
+			loops = 0;
+		}
+		cpu_relax();
+	}
+
+	/* Same RCsc upgrade as the generic ticket lock */
+	smp_mb();
+}
+EXPORT_SYMBOL(pv_ticket_lock_wait);
+#endif
+
+static bool __init has_pv_steal_clock(void)
+{
+	if (sbi_probe_extension(SBI_EXT_STA) > 0) {
+		pr_info("SBI STA extension detected\n");
+		return true;
+	}
+
+	return false;
+}
+
+int __init pv_time_init(void)
+{
+	int ret;
+
+	if (!has_pv_steal_clock())
+		return 0;
+
+	ret = cpuhp_setup_state(CPUHP_AP_ONLINE_DYN,
+				"riscv/pv_time:online",
+				pv_time_cpu_online,
+				pv_time_cpu_down_prepare);
+	if (ret < 0)
+		return ret;
+
+	static_call_update(pv_steal_clock, pv_time_steal_clock);
+
+	static_key_slow_inc(&paravirt_steal_enabled);
+	if (steal_acc)
+		static_key_slow_inc(&paravirt_steal_rq_enabled);
+
+	pr_info("Computing paravirt steal-time\n");
+
+	/* Only trust the experimental yield ID when STA says we are a guest */
+	if (sbi_probe_extension(SBI_EXT_PV_YIELD) > 0) {
+		static_branch_enable(&pv_yield_enabled);
+		pr_info("Using paravirt spin yield\n");
+	}
+
+	return 0;
+}
@@ -15,12 +15,17 @@
 #include <asm/patch.h>
 #include <asm/sections.h>
 
-struct patch_insn {
-	void *addr;
-	u32 insn;
+struct patch_rendezvous {
+	int (*fn)(void *data);
+	void *data;
 	atomic_t cpu_count;
 };
 
+struct patch_batch {
+	const struct riscv_patch_site *sites;
+	unsigned int nr;
+};
+
 int riscv_patch_in_stop_machine = false;
 
 #ifdef CONFIG_MMU
@@ -61,7 +66,7 @@ static void patch_unmap(int fixmap)
 }
 NOKPROBE_SYMBOL(patch_unmap);
 
-static int patch_insn_write(void *addr, const void *insn, size_t len)
+int patch_insn_write(void *addr, const void *insn, size_t len)
 {
 	void *waddr = addr;
 	bool across_pages = (((uintptr_t) addr & ~PAGE_MASK) + len) > PAGE_SIZE;
@@ -97,7 +102,7 @@ static int patch_insn_write(void *addr, const void *insn, size_t len)
 }
 NOKPROBE_SYMBOL(patch_insn_write);
 #else
-static int patch_insn_write(void *addr, const void *insn, size_t len)
+int patch_insn_write(void *addr, const void *insn, size_t len)
 {
 	return copy_to_kernel_nofault(addr, insn, len);
 }
@@ -118,35 +123,77 @@ int patch_text_nosync(void *addr, const void *insns, size_t len)
 }
 NOKPROBE_SYMBOL(patch_text_nosync);
 
+/*
+ * The last CPU to arrive does the patching while the others wait for it.
+ * Every CPU then synchronizes its own instruction fetch with a local
+ * fence.i, so no remote icache flush is needed however many sites were
+ * patched.
+ */
 static int patch_text_cb(void *data)
 {
-	struct patch_insn *patch = data;
+	struct patch_rendezvous *rv = data;
 	int ret = 0;
 
-	if (atomic_inc_return(&patch->cpu_count) == num_online_cpus()) {
-		ret =
-		    patch_text_nosync(patch->addr, &patch->insn,
-					    GET_INSN_LENGTH(patch->insn));
-		atomic_inc(&patch->cpu_count);
+	if (atomic_inc_return(&rv->cpu_count) == num_online_cpus()) {
+		ret = rv->fn(rv->data);
+		atomic_inc(&rv->cpu_count);
 	} else {
-		while (atomic_read(&patch->cpu_count) <= num_online_cpus())
+		while (atomic_read(&rv->cpu_count) <= num_online_cpus())
 			cpu_relax();
 		smp_mb();
 	}
 
+	local_flush_icache_all();
+
 	return ret;
 }
 NOKPROBE_SYMBOL(patch_text_cb);
 
-int patch_text(void *addr, u32 insn)
+/*
+ * Run @fn, which writes text with patch_insn_write(), while all the other
+ * online CPUs are parked in stop_machine. The caller holds the CPU hotplug
+ * lock.
+ */
+int patch_text_stop_machine(int (*fn)(void *data), void *data)
 {
-	int ret;
-	struct patch_insn patch = {
-		.addr = addr,
-		.insn = insn,
+	struct patch_rendezvous rv = {
+		.fn = fn,
+		.data = data,
 		.cpu_count = ATOMIC_INIT(0),
 	};
 
+	return stop_machine_cpuslocked(patch_text_cb, &rv, cpu_online_mask);
+}
+NOKPROBE_SYMBOL(patch_text_stop_machine);
+
+static int patch_text_batch_cb(void *data)
+{
+	struct patch_batch *batch = data;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < batch->nr; i++) {
+		const struct riscv_patch_site *site = &batch->sites[i];
+
+		ret = patch_insn_write(site->addr, &site->insn,
+				       GET_INSN_LENGTH(site->insn));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+NOKPROBE_SYMBOL(patch_text_batch_cb);
+
+/* Patch @nr sites in a single stop_machine() */
+int patch_text_batch(const struct riscv_patch_site *sites, unsigned int nr)
+{
+	struct patch_batch batch = {
+		.sites = sites,
+		.nr = nr,
+	};
+	int ret;
+
 	/*
 	 * kprobes takes text_mutex, before calling patch_text(), but as we call
 	 * calls stop_machine(), the lockdep assertion in patch_insn_write()
@@ -157,8 +204,19 @@ int patch_text(void *addr, u32 insn)
 	 */
 	lockdep_assert_held(&text_mutex);
 	riscv_patch_in_stop_machine = true;
-	ret = stop_machine_cpuslocked(patch_text_cb, &patch, cpu_online_mask);
+	ret = patch_text_stop_machine(patch_text_batch_cb, &batch);
 	riscv_patch_in_stop_machine = false;
 	return ret;
 }
+NOKPROBE_SYMBOL(patch_text_batch);
+
+int patch_text(void *addr, u32 insn)
+{
+	struct riscv_patch_site site = {
+		.addr = addr,
+		.insn = insn,
+	};
+
+	return patch_text_batch(&site, 1);
+}
 NOKPROBE_SYMBOL(patch_text);
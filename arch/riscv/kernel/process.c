@@ -127,7 +127,10 @@ void start_thread(struct pt_regs *regs, unsigned long pc,
 
 	if (has_vector()) {
 		regs->status |= SR_VS_INITIAL;
+		/* The registers and their owner must stay on the same CPU */
+		preempt_disable();
 		vstate_restore(current, regs);
+		preempt_enable();
 	}
 
 	regs->epc = pc;
@@ -154,11 +157,19 @@ void flush_thread(void)
 	fstate_off(current, task_pt_regs(current));
 	memset(&current->thread.fstate, 0, sizeof(current->thread.fstate));
 #endif
+#ifdef CONFIG_VECTOR
+	vstate_off(current, task_pt_regs(current));
+	memset(&current->thread.vstate, 0, sizeof(current->thread.vstate));
+	vstate_invalidate_task(current);
+	current->thread.vstate_parked = false;
+	current->thread.vstate_idle = 0;
+#endif
 }
 
 int arch_dup_task_struct(struct task_struct *dst, struct task_struct *src)
 {
 	fstate_save(src, task_pt_regs(src));
+	vstate_save(src, task_pt_regs(src));
 	*dst = *src;
 	return 0;
 }
@@ -171,6 +182,12 @@ int copy_thread(struct task_struct *p, const struct kernel_clone_args *args)
 	struct pt_regs *childregs = task_pt_regs(p);
 
 	memset(&p->thread.s, 0, sizeof(p->thread.s));
+#ifdef CONFIG_VECTOR
+	vstate_invalidate_task(p);
+	memset(&p->thread.vstat, 0, sizeof(p->thread.vstat));
+#endif
+	p->thread.misaligned_loads = 0;
+	p->thread.misaligned_stores = 0;
 
 	/* p->thread holds context to be restored by __switch_to() */
 	if (unlikely(args->fn)) {
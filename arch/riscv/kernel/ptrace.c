@@ -107,6 +107,7 @@ static int riscv_vr_set(struct task_struct *target,
 
 	ret = user_regset_copyin(&pos, &count, &kbuf, &ubuf, vstate, 0,
 			offsetof(struct __riscv_v_state, vtype));
+	vstate_invalidate_task(target);
 	return ret;
 }
 #endif
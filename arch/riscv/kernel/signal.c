@@ -98,7 +98,11 @@ static long restore_v_state(struct pt_regs *regs,
 	if (unlikely(err))
 		return err;
 
+	/* The registers and their owner must stay on the same CPU */
+	preempt_disable();
+	vstate_invalidate_task(current);
 	vstate_restore(current, regs);
+	preempt_enable();
 
 	return err;
 }
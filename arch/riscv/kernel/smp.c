@@ -10,6 +10,7 @@
 
 #include <linux/cpu.h>
 #include <linux/clockchips.h>
+#include <linux/debugfs.h>
 #include <linux/interrupt.h>
 #include <linux/module.h>
 #include <linux/kexec.h>
@@ -19,6 +20,8 @@
 #include <linux/seq_file.h>
 #include <linux/delay.h>
 #include <linux/irq_work.h>
+#include <linux/math64.h>
+#include <linux/sched/clock.h>
 
 #include <asm/sbi.h>
 #include <asm/tlbflush.h>
@@ -101,12 +104,117 @@ static inline void ipi_cpu_crash_stop(unsigned int cpu, struct pt_regs *regs)
 
 static const struct riscv_ipi_ops *ipi_ops __ro_after_init;
 
+DEFINE_STATIC_KEY_FALSE(riscv_ipi_for_rfence);
+EXPORT_SYMBOL_GPL(riscv_ipi_for_rfence);
+
+enum rfence_mode {
+	RFENCE_MODE_AUTO,
+	RFENCE_MODE_SBI,
+	RFENCE_MODE_IPI,
+};
+
+static enum rfence_mode rfence_mode __ro_after_init = RFENCE_MODE_AUTO;
+
+/*
+ * "riscv_rfence=sbi" keeps remote fences on the SBI RFENCE extension even
+ * when the IPI controller is S-mode visible, "riscv_rfence=ipi" forces
+ * the cross call path.  Both are mainly useful to compare the two paths
+ * on the same machine.
+ */
+static int __init riscv_rfence_setup(char *str)
+{
+	if (!str)
+		return -EINVAL;
+
+	if (!strcmp(str, "sbi"))
+		rfence_mode = RFENCE_MODE_SBI;
+	else if (!strcmp(str, "ipi"))
+		rfence_mode = RFENCE_MODE_IPI;
+	else if (!strcmp(str, "auto"))
+		rfence_mode = RFENCE_MODE_AUTO;
+	else
+		return -EINVAL;
+
+	return 0;
+}
+early_param("riscv_rfence", riscv_rfence_setup);
+
 void riscv_set_ipi_ops(const struct riscv_ipi_ops *ops)
 {
+	bool use_ipi;
+
 	ipi_ops = ops;
+
+	switch (rfence_mode) {
+	case RFENCE_MODE_SBI:
+		use_ipi = false;
+		break;
+	case RFENCE_MODE_IPI:
+		use_ipi = true;
+		break;
+	default:
+		use_ipi = ops->use_for_rfence;
+		break;
+	}
+
+	if (use_ipi)
+		static_branch_enable(&riscv_ipi_for_rfence);
+	else
+		static_branch_disable(&riscv_ipi_for_rfence);
 }
 EXPORT_SYMBOL_GPL(riscv_set_ipi_ops);
 
+struct rfence_stats {
+	unsigned long count[RISCV_RFENCE_MAX];
+	u64 nsecs[RISCV_RFENCE_MAX];
+};
+
+static DEFINE_PER_CPU(struct rfence_stats, rfence_stats);
+
+void riscv_rfence_account(enum riscv_rfence_path path, u64 start_ns)
+{
+	this_cpu_inc(rfence_stats.count[path]);
+	this_cpu_add(rfence_stats.nsecs[path], local_clock() - start_ns);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static const char * const rfence_path_names[] = {
+	[RISCV_RFENCE_SBI]	= "sbi",
+	[RISCV_RFENCE_IPI]	= "ipi",
+};
+
+static int rfence_stats_show(struct seq_file *m, void *v)
+{
+	unsigned long count;
+	unsigned int cpu, i;
+	u64 nsecs;
+
+	seq_printf(m, "mode: %s\n", riscv_use_ipi_for_rfence() ? "ipi" : "sbi");
+	seq_puts(m, "path          count       total_ns     avg_ns\n");
+	for (i = 0; i < RISCV_RFENCE_MAX; i++) {
+		count = 0;
+		nsecs = 0;
+		for_each_possible_cpu(cpu) {
+			count += per_cpu(rfence_stats, cpu).count[i];
+			nsecs += per_cpu(rfence_stats, cpu).nsecs[i];
+		}
+		seq_printf(m, "%-4s %14lu %14llu %10llu\n", rfence_path_names[i],
+			   count, nsecs, count ? div64_ul(nsecs, count) : 0);
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rfence_stats);
+
+static int __init rfence_stats_init(void)
+{
+	debugfs_create_file("riscv_rfence", 0400, NULL, NULL,
+			    &rfence_stats_fops);
+	return 0;
+}
+late_initcall(rfence_stats_init);
+#endif /* CONFIG_DEBUG_FS */
+
 void riscv_clear_ipi(void)
 {
 	if (ipi_ops && ipi_ops->ipi_clear)
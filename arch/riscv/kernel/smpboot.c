@@ -9,6 +9,7 @@
  */
 
 #include <linux/arch_topology.h>
+#include <linux/cacheinfo.h>
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
@@ -41,6 +42,35 @@ void __init smp_prepare_boot_cpu(void)
 {
 }
 
+/*
+ * Start the harts that smp_init() is going to bring up all at once, so
+ * that their firmware start latency overlaps. Each one then waits in the
+ * entry code until __cpu_up() hands over its idle task.
+ */
+static void __init smp_prestart_cpus(unsigned int max_cpus)
+{
+	unsigned int nr_started = 1;
+	int cpuid;
+
+	for_each_present_cpu(cpuid) {
+		if (nr_started >= max_cpus)
+			break;
+		if (cpuid == smp_processor_id())
+			continue;
+		if (cpu_ops[cpuid]->cpu_prestart &&
+		    !cpu_ops[cpuid]->cpu_prestart(cpuid))
+			nr_started++;
+	}
+
+	/*
+	 * Fill in the cache leaves while the harts come up, so that only
+	 * the shared maps are left for store_cpu_topology() on each hart.
+	 */
+	for_each_present_cpu(cpuid)
+		if (cpuid != smp_processor_id())
+			fetch_cache_info(cpuid);
+}
+
 void __init smp_prepare_cpus(unsigned int max_cpus)
 {
 	int cpuid;
@@ -69,6 +99,8 @@ void __init smp_prepare_cpus(unsigned int max_cpus)
 		set_cpu_present(cpuid, true);
 		numa_store_cpu_info(cpuid);
 	}
+
+	smp_prestart_cpus(max_cpus);
 }
 
 void __init setup_smp(void)
@@ -148,6 +180,16 @@ int __cpu_up(unsigned int cpu, struct task_struct *tidle)
 
 void __init smp_cpus_done(unsigned int max_cpus)
 {
+	int cpuid;
+
+	/*
+	 * Harts prestarted for cpus that did not come up are still waiting
+	 * for their boot data, send them back to the firmware.
+	 */
+	for_each_present_cpu(cpuid) {
+		if (!cpu_online(cpuid) && cpu_ops[cpuid]->cpu_prestart_cancel)
+			cpu_ops[cpuid]->cpu_prestart_cancel(cpuid);
+	}
 }
 
 /*
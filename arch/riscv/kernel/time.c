@@ -8,6 +8,7 @@
 #include <linux/clockchips.h>
 #include <linux/clocksource.h>
 #include <linux/delay.h>
+#include <asm/paravirt.h>
 #include <asm/sbi.h>
 #include <asm/processor.h>
 #include <asm/timex.h>
@@ -32,6 +33,8 @@ void __init time_init(void)
 	timer_probe();
 
 	tick_setup_hrtimer_broadcast();
+
+	pv_time_init();
 }
 
 void clocksource_arch_init(struct clocksource *cs)
@@ -8,6 +8,7 @@
 #include <linux/init.h>
 #include <linux/sched.h>
 #include <linux/sched/debug.h>
+#include <linux/sched/mm.h>
 #include <linux/sched/signal.h>
 #include <linux/signal.h>
 #include <linux/kdebug.h>
@@ -17,11 +18,16 @@
 #include <linux/module.h>
 #include <linux/irq.h>
 #include <linux/kexec.h>
+#include <linux/perf_event.h>
+#include <linux/prctl.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #include <asm/asm-prototypes.h>
 #include <asm/bug.h>
 #include <asm/csr.h>
 #include <asm/processor.h>
+#include <asm/switch_to.h>
 #include <asm/ptrace.h>
 #include <asm/thread_info.h>
 
@@ -112,34 +118,103 @@ DO_ERROR_INFO(do_trap_insn_misaligned,
 	SIGBUS, BUS_ADRALN, "instruction address misaligned");
 DO_ERROR_INFO(do_trap_insn_fault,
 	SIGSEGV, SEGV_ACCERR, "instruction access fault");
-DO_ERROR_INFO(do_trap_insn_illegal,
-	SIGILL, ILL_ILLOPC, "illegal instruction");
+
+asmlinkage __visible __trap_section void do_trap_insn_illegal(struct pt_regs *regs)
+{
+	if (user_mode(regs) && vstate_unpark(current, regs))
+		return;
+
+	do_trap_error(regs, SIGILL, ILL_ILLOPC, regs->epc,
+		      "Oops - illegal instruction");
+}
+
 DO_ERROR_INFO(do_trap_load_fault,
 	SIGSEGV, SEGV_ACCERR, "load access fault");
+
+int riscv_set_unalign_ctl(struct task_struct *tsk, unsigned int val)
+{
+	if (val & ~(PR_UNALIGN_NOPRINT | PR_UNALIGN_SIGBUS))
+		return -EINVAL;
+
+	tsk->thread.align_ctl = val;
+	return 0;
+}
+
+int riscv_get_unalign_ctl(struct task_struct *tsk, unsigned long addr)
+{
+	return put_user(tsk->thread.align_ctl, (unsigned int __user *)addr);
+}
+
+/*
+ * Traps the firmware emulates never reach us; those are counted by the SBI
+ * PMU firmware events instead.
+ */
+static void misaligned_account(struct pt_regs *regs, bool store)
+{
+	perf_sw_event(PERF_COUNT_SW_ALIGNMENT_FAULTS, 1, regs, regs->badaddr);
+
+	if (!user_mode(regs))
+		return;
+
+	if (store)
+		current->thread.misaligned_stores++;
+	else
+		current->thread.misaligned_loads++;
+	if (current->mm)
+		atomic_long_inc(&current->mm->context.misaligned_count);
+}
+
 #ifndef CONFIG_RISCV_M_MODE
-DO_ERROR_INFO(do_trap_load_misaligned,
-	SIGBUS, BUS_ADRALN, "Oops - load address misaligned");
-DO_ERROR_INFO(do_trap_store_misaligned,
-	SIGBUS, BUS_ADRALN, "Oops - store (or AMO) address misaligned");
+static inline int handle_misaligned_load(struct pt_regs *regs) { return -1; }
+static inline int handle_misaligned_store(struct pt_regs *regs) { return -1; }
 #else
 int handle_misaligned_load(struct pt_regs *regs);
 int handle_misaligned_store(struct pt_regs *regs);
+#endif
 
-asmlinkage void __trap_section do_trap_load_misaligned(struct pt_regs *regs)
+asmlinkage __visible __trap_section void do_trap_load_misaligned(struct pt_regs *regs)
 {
+	misaligned_account(regs, false);
 	if (!handle_misaligned_load(regs))
 		return;
 	do_trap_error(regs, SIGBUS, BUS_ADRALN, regs->epc,
 		      "Oops - load address misaligned");
 }
 
-asmlinkage void __trap_section do_trap_store_misaligned(struct pt_regs *regs)
+asmlinkage __visible __trap_section void do_trap_store_misaligned(struct pt_regs *regs)
 {
+	misaligned_account(regs, true);
 	if (!handle_misaligned_store(regs))
 		return;
 	do_trap_error(regs, SIGBUS, BUS_ADRALN, regs->epc,
 		      "Oops - store (or AMO) address misaligned");
 }
+
+#ifdef CONFIG_PROC_FS
+void arch_proc_pid_thread_features(struct seq_file *m,
+				   struct task_struct *task)
+{
+	struct mm_struct *mm;
+
+	if (task->flags & PF_KTHREAD)
+		return;
+
+	seq_put_decimal_ull(m, "MisalignedLoads:\t",
+			    task->thread.misaligned_loads);
+	seq_put_decimal_ull(m, "\nMisalignedStores:\t",
+			    task->thread.misaligned_stores);
+	mm = get_task_mm(task);
+	if (mm) {
+		seq_put_decimal_ull(m, "\nMisalignedProcess:\t",
+				    atomic_long_read(&mm->context.misaligned_count));
+		mmput(mm);
+	}
+	seq_put_decimal_ull(m, "\nMisalignedSigbus:\t",
+			    !!(task->thread.align_ctl & PR_UNALIGN_SIGBUS));
+	seq_putc(m, '\n');
+
+	vstate_proc_show(m, task);
+}
 #endif
 DO_ERROR_INFO(do_trap_store_fault,
 	SIGSEGV, SEGV_ACCERR, "store (or AMO) access fault");
@@ -7,6 +7,7 @@
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/irq.h>
+#include <linux/prctl.h>
 #include <linux/stringify.h>
 
 #include <asm/processor.h>
@@ -231,17 +232,84 @@ static inline ulong get_insn(ulong mepc)
 
 union reg_data {
 	u8 data_bytes[8];
+	u16 data_u16[4];
+	u32 data_u32[2];
 	ulong data_ulong;
 	u64 data_u64;
 };
 
+/*
+ * Largest naturally aligned granule, smaller than the access itself, that
+ * addr is aligned to. An access that is only off by half its size (or a
+ * quarter for a doubleword) is emulated with two (four) aligned accesses
+ * rather than one per byte.
+ */
+static inline int misaligned_granule(unsigned long addr, int len)
+{
+	int g = len >> 1;
+
+	while (g > 1 && (addr & (g - 1)))
+		g >>= 1;
+	return g;
+}
+
+static void misaligned_read(union reg_data *val, unsigned long addr, int len)
+{
+	int i;
+
+	switch (misaligned_granule(addr, len)) {
+	case 4:
+		for (i = 0; i < len / 4; i++)
+			val->data_u32[i] = load_u32((void *)(addr + 4 * i));
+		break;
+	case 2:
+		for (i = 0; i < len / 2; i++)
+			val->data_u16[i] = load_u16((void *)(addr + 2 * i));
+		break;
+	default:
+		for (i = 0; i < len; i++)
+			val->data_bytes[i] = load_u8((void *)(addr + i));
+		break;
+	}
+}
+
+static void misaligned_write(union reg_data *val, unsigned long addr, int len)
+{
+	int i;
+
+	switch (misaligned_granule(addr, len)) {
+	case 4:
+		for (i = 0; i < len / 4; i++)
+			store_u32((void *)(addr + 4 * i), val->data_u32[i]);
+		break;
+	case 2:
+		for (i = 0; i < len / 2; i++)
+			store_u16((void *)(addr + 2 * i), val->data_u16[i]);
+		break;
+	default:
+		for (i = 0; i < len; i++)
+			store_u8((void *)(addr + i), val->data_bytes[i]);
+		break;
+	}
+}
+
+/* The task asked for SIGBUS instead of emulation, see PR_SET_UNALIGN */
+static inline bool misaligned_sigbus(struct pt_regs *regs)
+{
+	return user_mode(regs) &&
+	       (current->thread.align_ctl & PR_UNALIGN_SIGBUS);
+}
+
 int handle_misaligned_load(struct pt_regs *regs)
 {
 	union reg_data val;
 	unsigned long epc = regs->epc;
 	unsigned long insn = get_insn(epc);
 	unsigned long addr = csr_read(mtval);
-	int i, fp = 0, shift = 0, len = 0;
+	int fp = 0, shift = 0, len = 0;
+
+	if (misaligned_sigbus(regs))
+		return -1;
 
 	regs->epc = 0;
 
@@ -306,8 +374,7 @@ int handle_misaligned_load(struct pt_regs *regs)
 	}
 
 	val.data_u64 = 0;
-	for (i = 0; i < len; i++)
-		val.data_bytes[i] = load_u8((void *)(addr + i));
+	misaligned_read(&val, addr, len);
 
 	if (fp)
 		return -1;
@@ -324,7 +391,10 @@ int handle_misaligned_store(struct pt_regs *regs)
 	unsigned long epc = regs->epc;
 	unsigned long insn = get_insn(epc);
 	unsigned long addr = csr_read(mtval);
-	int i, len = 0;
+	int len = 0;
+
+	if (misaligned_sigbus(regs))
+		return -1;
 
 	regs->epc = 0;
 
@@ -357,8 +427,7 @@ int handle_misaligned_store(struct pt_regs *regs)
 		return -1;
 	}
 
-	for (i = 0; i < len; i++)
-		store_u8((void *)(addr + i), val.data_bytes[i]);
+	misaligned_write(&val, addr, len);
 
 	regs->epc = epc + INSN_LEN(insn);
 
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Lazy vector context switching
+ *
+ * A task's vector registers are only written back when sstatus.VS says
+ * they are dirty, and only reloaded when another task (or the kernel)
+ * used the unit on this CPU since the task last ran here. Tasks that
+ * keep the unit enabled without touching it can additionally have it
+ * turned off after a number of idle switches; the next vector
+ * instruction then traps and the state is brought back.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpu_pm.h>
+#include <linux/init.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/sched/task_stack.h>
+#include <linux/seq_file.h>
+#include <linux/sysctl.h>
+
+#include <asm/csr.h>
+#include <asm/switch_to.h>
+
+DEFINE_PER_CPU(struct task_struct *, vstate_last_owner);
+
+/* Number of clean switch-outs before access is dropped, 0 disables it */
+static unsigned int vstate_idle_switches __read_mostly;
+
+void vstate_switch_out(struct task_struct *task, struct pt_regs *regs)
+{
+	struct thread_struct *thread = &task->thread;
+
+	if ((regs->status & SR_VS) == SR_VS_DIRTY) {
+		vstate_save(task, regs);
+		thread->vstate_idle = 0;
+	} else {
+		thread->vstat.saves_skipped++;
+		thread->vstate_idle++;
+	}
+
+	/* Saving leaves the registers matching the memory copy */
+	vstate_set_owner(task);
+
+	if (vstate_idle_switches &&
+	    thread->vstate_idle >= vstate_idle_switches) {
+		vstate_off(task, regs);
+		thread->vstate_parked = true;
+		thread->vstat.parks++;
+	}
+}
+
+/*
+ * Called on an illegal instruction trap from user mode. If the task had
+ * its vector access dropped, give it back and let it retry the
+ * instruction; a genuinely illegal one will simply trap again.
+ */
+bool vstate_unpark(struct task_struct *task, struct pt_regs *regs)
+{
+	struct thread_struct *thread = &task->thread;
+
+	if (!has_vector() || !thread->vstate_parked)
+		return false;
+
+	thread->vstate_parked = false;
+	thread->vstate_idle = 0;
+	thread->vstat.unparks++;
+
+	/*
+	 * Nothing else may run on this CPU between turning the unit back on
+	 * and making the registers match, or a switch-out would record the
+	 * wrong owner.
+	 */
+	preempt_disable();
+	__vstate_clean(regs);
+	if (vstate_is_live(task))
+		thread->vstat.restores_skipped++;
+	else
+		vstate_restore(task, regs);
+	preempt_enable();
+
+	return true;
+}
+
+#ifdef CONFIG_PROC_FS
+static const char *vstate_name(struct task_struct *task)
+{
+	if (task->thread.vstate_parked)
+		return "parked";
+
+	switch (task_pt_regs(task)->status & SR_VS) {
+	case SR_VS_INITIAL:
+		return "initial";
+	case SR_VS_CLEAN:
+		return "clean";
+	case SR_VS_DIRTY:
+		return "dirty";
+	default:
+		return "off";
+	}
+}
+
+void vstate_proc_show(struct seq_file *m, struct task_struct *task)
+{
+	struct riscv_vstate_stats *st = &task->thread.vstat;
+
+	if (!has_vector() || (task->flags & PF_KTHREAD))
+		return;
+
+	seq_printf(m, "VectorState:\t%s\n", vstate_name(task));
+	seq_put_decimal_ull(m, "VectorSaves:\t", st->saves);
+	seq_put_decimal_ull(m, "\nVectorSavesSkipped:\t", st->saves_skipped);
+	seq_put_decimal_ull(m, "\nVectorRestores:\t", st->restores);
+	seq_put_decimal_ull(m, "\nVectorRestoresSkipped:\t",
+			    st->restores_skipped);
+	seq_put_decimal_ull(m, "\nVectorParks:\t", st->parks);
+	seq_put_decimal_ull(m, "\nVectorUnparks:\t", st->unparks);
+	seq_put_decimal_ull(m, "\nVectorBytesNotCopied:\t",
+			    (u64)(st->saves_skipped + st->restores_skipped) *
+			    sizeof(struct __riscv_v_state));
+	seq_putc(m, '\n');
+}
+#endif /* CONFIG_PROC_FS */
+
+/* The register file does not survive hotplug or deep idle */
+static int vstate_cpu_online(unsigned int cpu)
+{
+	vstate_invalidate_cpu();
+	return 0;
+}
+
+#ifdef CONFIG_CPU_PM
+static int vstate_cpu_pm_notifier(struct notifier_block *self,
+				  unsigned long cmd, void *v)
+{
+	if (cmd == CPU_PM_ENTER)
+		vstate_invalidate_cpu();
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block vstate_cpu_pm_notifier_block = {
+	.notifier_call = vstate_cpu_pm_notifier,
+};
+#endif
+
+static struct ctl_table vstate_sysctl_table[] = {
+	{
+		.procname	= "riscv_v_idle_switches",
+		.data		= &vstate_idle_switches,
+		.maxlen		= sizeof(vstate_idle_switches),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec,
+	},
+	{ }
+};
+
+static int __init vstate_init(void)
+{
+	if (!has_vector())
+		return 0;
+
+	cpuhp_setup_state_nocalls(CPUHP_AP_ONLINE_DYN, "riscv/vstate:online",
+				  vstate_cpu_online, NULL);
+#ifdef CONFIG_CPU_PM
+	cpu_pm_register_notifier(&vstate_cpu_pm_notifier_block);
+#endif
+	register_sysctl("abi", vstate_sysctl_table);
+
+	return 0;
+}
+core_initcall(vstate_init);
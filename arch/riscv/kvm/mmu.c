@@ -123,6 +123,12 @@ static bool gstage_get_leaf_entry(struct kvm *kvm, gpa_t addr,
 	return false;
 }
 
+enum gstage_op {
+	GSTAGE_OP_NOP = 0,	/* Nothing */
+	GSTAGE_OP_CLEAR,	/* Clear/Unmap */
+	GSTAGE_OP_WP,		/* Write-protect */
+};
+
 static void gstage_remote_tlb_flush(struct kvm *kvm, u32 level, gpa_t addr)
 {
 	unsigned long order = PAGE_SHIFT;
@@ -134,10 +140,54 @@ static void gstage_remote_tlb_flush(struct kvm *kvm, u32 level, gpa_t addr)
 	kvm_riscv_hfence_gvma_vmid_gpa(kvm, -1UL, 0, addr, BIT(order), order);
 }
 
+static void gstage_op_pte(struct kvm *kvm, gpa_t addr,
+			  pte_t *ptep, u32 ptep_level, enum gstage_op op);
+
+/*
+ * Replace a block mapping with a table of next-level mappings covering the
+ * same range with the same permissions. Used when dirty logging needs to
+ * make a single page writable inside a write-protected block.
+ */
+static int gstage_split_leaf(struct kvm *kvm,
+			     struct kvm_mmu_memory_cache *pcache,
+			     pte_t *ptep, u32 level, gpa_t addr, bool flush)
+{
+	int i, ret;
+	pte_t *next_ptep;
+	pgprot_t prot;
+	unsigned long pfn, next_page_size;
+
+	if (!pcache)
+		return -ENOMEM;
+
+	ret = gstage_level_to_page_size(level - 1, &next_page_size);
+	if (ret)
+		return ret;
+
+	next_ptep = kvm_mmu_memory_cache_alloc(pcache);
+	if (!next_ptep)
+		return -ENOMEM;
+
+	pfn = __page_val_to_pfn(pte_val(*ptep));
+	prot = __pgprot(pte_val(*ptep) & ~_PAGE_PFN_MASK);
+	for (i = 0; i < PTRS_PER_PTE; i++)
+		next_ptep[i] = pfn_pte(pfn + i * (next_page_size >> PAGE_SHIFT),
+				       prot);
+
+	set_pte(ptep, pfn_pte(PFN_DOWN(__pa(next_ptep)),
+			      __pgprot(_PAGE_TABLE)));
+	if (flush)
+		gstage_remote_tlb_flush(kvm, level, addr);
+
+	return 0;
+}
+
 static int gstage_set_pte(struct kvm *kvm, u32 level,
 			   struct kvm_mmu_memory_cache *pcache,
 			   gpa_t addr, const pte_t *new_pte)
 {
+	int ret;
+	unsigned long page_size;
 	u32 current_level = gstage_pgd_levels - 1;
 	pte_t *next_ptep = (pte_t *)kvm->arch.pgd;
 	pte_t *ptep = &next_ptep[gstage_pte_index(addr, current_level)];
@@ -146,8 +196,12 @@ static int gstage_set_pte(struct kvm *kvm, u32 level,
 		return -EINVAL;
 
 	while (current_level != level) {
-		if (gstage_pte_leaf(ptep))
-			return -EEXIST;
+		if (gstage_pte_leaf(ptep)) {
+			ret = gstage_split_leaf(kvm, pcache, ptep,
+						current_level, addr, true);
+			if (ret)
+				return ret;
+		}
 
 		if (!pte_val(*ptep)) {
 			if (!pcache)
@@ -167,6 +221,19 @@ static int gstage_set_pte(struct kvm *kvm, u32 level,
 		ptep = &next_ptep[gstage_pte_index(addr, current_level)];
 	}
 
+	/*
+	 * A block mapping is replacing a table of smaller mappings (e.g.
+	 * after dirty logging was turned off), so tear the table down first.
+	 */
+	if (current_level && pte_val(*ptep) && !gstage_pte_leaf(ptep) &&
+	    gstage_pte_leaf(new_pte)) {
+		ret = gstage_level_to_page_size(current_level, &page_size);
+		if (ret)
+			return ret;
+		gstage_op_pte(kvm, addr & ~(page_size - 1), ptep,
+			      current_level, GSTAGE_OP_CLEAR);
+	}
+
 	*ptep = *new_pte;
 	if (gstage_pte_leaf(ptep))
 		gstage_remote_tlb_flush(kvm, current_level, addr);
@@ -219,12 +286,6 @@ static int gstage_map_page(struct kvm *kvm,
 	return gstage_set_pte(kvm, level, pcache, gpa, &new_pte);
 }
 
-enum gstage_op {
-	GSTAGE_OP_NOP = 0,	/* Nothing */
-	GSTAGE_OP_CLEAR,	/* Clear/Unmap */
-	GSTAGE_OP_WP,		/* Write-protect */
-};
-
 static void gstage_op_pte(struct kvm *kvm, gpa_t addr,
 			  pte_t *ptep, u32 ptep_level, enum gstage_op op)
 {
@@ -302,7 +363,13 @@ static void gstage_unmap_range(struct kvm *kvm, gpa_t start,
 	}
 }
 
-static void gstage_wp_range(struct kvm *kvm, gpa_t start, gpa_t end)
+/*
+ * Blocks that [start, end) only partially covers are write-protected as a
+ * whole: they are left behind when splitting them failed, and must not stay
+ * writable while dirty logging relies on write faults.
+ */
+static void gstage_wp_range(struct kvm *kvm, gpa_t start, gpa_t end,
+			    bool may_block)
 {
 	int ret;
 	pte_t *ptep;
@@ -318,16 +385,75 @@ static void gstage_wp_range(struct kvm *kvm, gpa_t start, gpa_t end)
 		if (ret)
 			break;
 
-		if (!found_leaf)
-			goto next;
-
-		if (!(addr & (page_size - 1)) && ((end - addr) >= page_size))
+		addr &= ~(page_size - 1);
+		if (found_leaf)
 			gstage_op_pte(kvm, addr, ptep,
 				      ptep_level, GSTAGE_OP_WP);
 
-next:
 		addr += page_size;
+
+		/* Same as gstage_unmap_range(), don't hog mmu_lock */
+		if (may_block && addr < end)
+			cond_resched_lock(&kvm->mmu_lock);
+	}
+}
+
+/*
+ * Break every block mapping overlapping [start, end) down to PAGE_SIZE
+ * mappings ahead of dirty logging, so that the write faults taken while
+ * logging don't each have to split a block. Splitting keeps the existing
+ * translations, so no TLB maintenance is needed here; the caller flushes
+ * after write-protecting the range.
+ *
+ * Called and returns with kvm->mmu_lock held, but drops it to refill the
+ * split page cache and to reschedule. The cache is serialised by
+ * kvm->slots_lock.
+ */
+static int gstage_split_range(struct kvm *kvm, gpa_t start, gpa_t end)
+{
+	struct kvm_mmu_memory_cache *pcache = &kvm->arch.split_page_cache;
+	unsigned long page_size;
+	bool found_leaf;
+	gpa_t addr = start;
+	u32 ptep_level;
+	pte_t *ptep;
+	int ret = 0;
+
+	lockdep_assert_held(&kvm->slots_lock);
+
+	while (addr < end) {
+		found_leaf = gstage_get_leaf_entry(kvm, addr,
+						   &ptep, &ptep_level);
+		ret = gstage_level_to_page_size(ptep_level, &page_size);
+		if (ret)
+			break;
+
+		if (found_leaf && ptep_level) {
+			if (!kvm_mmu_memory_cache_nr_free_objects(pcache)) {
+				spin_unlock(&kvm->mmu_lock);
+				ret = kvm_mmu_topup_memory_cache(pcache,
+							gstage_pgd_levels);
+				spin_lock(&kvm->mmu_lock);
+				if (ret)
+					break;
+				/* The tables may have changed meanwhile */
+				continue;
+			}
+
+			ret = gstage_split_leaf(kvm, pcache, ptep, ptep_level,
+						addr & ~(page_size - 1), false);
+			if (ret)
+				break;
+			kvm->stat.gstage_splits++;
+			continue;
+		}
+
+		addr = (addr & ~(page_size - 1)) + page_size;
+		if (addr < end)
+			cond_resched_lock(&kvm->mmu_lock);
 	}
+
+	return ret;
 }
 
 static void gstage_wp_memory_region(struct kvm *kvm, int slot)
@@ -338,8 +464,14 @@ static void gstage_wp_memory_region(struct kvm *kvm, int slot)
 	phys_addr_t end = (memslot->base_gfn + memslot->npages) << PAGE_SHIFT;
 
 	spin_lock(&kvm->mmu_lock);
-	gstage_wp_range(kvm, start, end);
+	/*
+	 * If a split fails, the block is write-protected whole and write
+	 * faults split it lazily instead.
+	 */
+	gstage_split_range(kvm, start, end);
+	gstage_wp_range(kvm, start, end, true);
 	spin_unlock(&kvm->mmu_lock);
+	kvm_mmu_free_memory_cache(&kvm->arch.split_page_cache);
 	kvm_flush_remote_tlbs(kvm);
 }
 
@@ -399,7 +531,15 @@ void kvm_arch_mmu_enable_log_dirty_pt_masked(struct kvm *kvm,
 	phys_addr_t start = (base_gfn +  __ffs(mask)) << PAGE_SHIFT;
 	phys_addr_t end = (base_gfn + __fls(mask) + 1) << PAGE_SHIFT;
 
-	gstage_wp_range(kvm, start, end);
+	/*
+	 * With KVM_DIRTY_LOG_INITIALLY_SET nothing was write-protected when
+	 * logging was enabled, so split the blocks of this chunk now. Blocks
+	 * that fail to split are write-protected whole below.
+	 */
+	if (kvm_dirty_log_manual_protect_and_init_set(kvm))
+		gstage_split_range(kvm, start, end);
+
+	gstage_wp_range(kvm, start, end, false);
 }
 
 void kvm_arch_sync_dirty_log(struct kvm *kvm, struct kvm_memory_slot *memslot)
@@ -445,9 +585,19 @@ void kvm_arch_commit_memory_region(struct kvm *kvm,
 	 * At this point memslot has been committed and there is an
 	 * allocated dirty_bitmap[], dirty pages will be tracked while
 	 * the memory slot is write protected.
+	 *
+	 * With KVM_DIRTY_LOG_INITIALLY_SET, userspace write-protects the
+	 * slot in chunks through KVM_CLEAR_DIRTY_LOG instead.
 	 */
-	if (change != KVM_MR_DELETE && new->flags & KVM_MEM_LOG_DIRTY_PAGES)
+	if (change != KVM_MR_DELETE && new->flags & KVM_MEM_LOG_DIRTY_PAGES &&
+	    !kvm_dirty_log_manual_protect_and_init_set(kvm))
 		gstage_wp_memory_region(kvm, new->id);
+
+	/* The chunked splits of KVM_CLEAR_DIRTY_LOG are over for this slot */
+	if (change == KVM_MR_DELETE ||
+	    (old && old->flags & KVM_MEM_LOG_DIRTY_PAGES &&
+	     !(new->flags & KVM_MEM_LOG_DIRTY_PAGES)))
+		kvm_mmu_free_memory_cache(&kvm->arch.split_page_cache);
 }
 
 int kvm_arch_prepare_memory_region(struct kvm *kvm,
@@ -587,7 +737,8 @@ bool kvm_age_gfn(struct kvm *kvm, struct kvm_gfn_range *range)
 	if (!kvm->arch.pgd)
 		return false;
 
-	WARN_ON(size != PAGE_SIZE && size != PMD_SIZE && size != PGDIR_SIZE);
+	WARN_ON(size != PAGE_SIZE && size != PMD_SIZE && size != PUD_SIZE &&
+		size != PGDIR_SIZE);
 
 	if (!gstage_get_leaf_entry(kvm, range->start << PAGE_SHIFT,
 				   &ptep, &ptep_level))
@@ -605,7 +756,8 @@ bool kvm_test_age_gfn(struct kvm *kvm, struct kvm_gfn_range *range)
 	if (!kvm->arch.pgd)
 		return false;
 
-	WARN_ON(size != PAGE_SIZE && size != PMD_SIZE && size != PGDIR_SIZE);
+	WARN_ON(size != PAGE_SIZE && size != PMD_SIZE && size != PUD_SIZE &&
+		size != PGDIR_SIZE);
 
 	if (!gstage_get_leaf_entry(kvm, range->start << PAGE_SHIFT,
 				   &ptep, &ptep_level))
@@ -614,6 +766,97 @@ bool kvm_test_age_gfn(struct kvm *kvm, struct kvm_gfn_range *range)
 	return pte_young(*ptep);
 }
 
+static bool fault_supports_gstage_huge_mapping(struct kvm_memory_slot *memslot,
+					       unsigned long hva,
+					       unsigned long map_size)
+{
+	gpa_t gpa_start;
+	hva_t uaddr_start, uaddr_end;
+	size_t size;
+
+	size = memslot->npages * PAGE_SIZE;
+	uaddr_start = memslot->userspace_addr;
+	uaddr_end = uaddr_start + size;
+	gpa_start = memslot->base_gfn << PAGE_SHIFT;
+
+	/*
+	 * A block mapping is only possible if the GPA and the HVA have the
+	 * same offset within the block, and the whole block lies inside
+	 * the memslot.
+	 */
+	if ((gpa_start & (map_size - 1)) != (uaddr_start & (map_size - 1)))
+		return false;
+
+	return (hva & ~(map_size - 1)) >= uaddr_start &&
+	       (hva & ~(map_size - 1)) + map_size <= uaddr_end;
+}
+
+/*
+ * Size of the host mapping backing @hva. Walks current->mm locklessly, so
+ * must be called with kvm->mmu_lock held after mmu_invalidate_retry() has
+ * confirmed that the pfn is still mapped there.
+ */
+static unsigned long gstage_host_mapping_size(struct kvm *kvm,
+					      unsigned long hva)
+{
+	unsigned long flags, size = PAGE_SIZE;
+	pgd_t pgd;
+	p4d_t p4d;
+	pud_t pud;
+	pmd_t pmd;
+
+	local_irq_save(flags);
+
+	pgd = READ_ONCE(*pgd_offset(kvm->mm, hva));
+	if (pgd_none(pgd))
+		goto out;
+
+	p4d = READ_ONCE(*p4d_offset(&pgd, hva));
+	if (p4d_none(p4d) || !p4d_present(p4d))
+		goto out;
+
+	pud = READ_ONCE(*pud_offset(&p4d, hva));
+	if (pud_none(pud) || !pud_present(pud))
+		goto out;
+	if (pud_leaf(pud)) {
+		size = PUD_SIZE;
+		goto out;
+	}
+
+	pmd = READ_ONCE(*pmd_offset(&pud, hva));
+	if (pmd_present(pmd) && pmd_leaf(pmd))
+		size = PMD_SIZE;
+
+out:
+	local_irq_restore(flags);
+	return size;
+}
+
+/*
+ * If the faulting page is part of a transparent huge page that is mapped
+ * by a PMD on the host, map the whole block in the G-stage as well. The
+ * reference taken by gfn_to_pfn_prot() is moved to the head page.
+ */
+static unsigned long transparent_hugepage_adjust(struct kvm *kvm,
+						 struct kvm_memory_slot *memslot,
+						 unsigned long hva,
+						 kvm_pfn_t *hfnp, gpa_t *gpap)
+{
+	kvm_pfn_t hfn = *hfnp;
+
+	if (!fault_supports_gstage_huge_mapping(memslot, hva, PMD_SIZE) ||
+	    gstage_host_mapping_size(kvm, hva) < PMD_SIZE)
+		return PAGE_SIZE;
+
+	*gpap &= PMD_MASK;
+	kvm_release_pfn_clean(hfn);
+	hfn &= ~(PTRS_PER_PMD - 1);
+	get_page(pfn_to_page(hfn));
+	*hfnp = hfn;
+
+	return PMD_SIZE;
+}
+
 int kvm_riscv_gstage_map(struct kvm_vcpu *vcpu,
 			 struct kvm_memory_slot *memslot,
 			 gpa_t gpa, unsigned long hva, bool is_write)
@@ -621,6 +864,7 @@ int kvm_riscv_gstage_map(struct kvm_vcpu *vcpu,
 	int ret;
 	kvm_pfn_t hfn;
 	bool writable;
+	bool thp_allowed;
 	short vma_pageshift;
 	gfn_t gfn = gpa >> PAGE_SHIFT;
 	struct vm_area_struct *vma;
@@ -654,8 +898,20 @@ int kvm_riscv_gstage_map(struct kvm_vcpu *vcpu,
 	if (logging || (vma->vm_flags & VM_PFNMAP))
 		vma_pagesize = PAGE_SIZE;
 
-	if (vma_pagesize == PMD_SIZE || vma_pagesize == PGDIR_SIZE)
-		gfn = (gpa & huge_page_mask(hstate_vma(vma))) >> PAGE_SHIFT;
+	/* Fall back to smaller blocks if the memslot layout requires it */
+	if (vma_pagesize == PUD_SIZE &&
+	    !fault_supports_gstage_huge_mapping(memslot, hva, PUD_SIZE))
+		vma_pagesize = PMD_SIZE;
+	if (vma_pagesize == PMD_SIZE &&
+	    !fault_supports_gstage_huge_mapping(memslot, hva, PMD_SIZE))
+		vma_pagesize = PAGE_SIZE;
+
+	if (vma_pagesize != PAGE_SIZE) {
+		gpa &= ~(vma_pagesize - 1);
+		gfn = gpa >> PAGE_SHIFT;
+	}
+	thp_allowed = vma_pagesize == PAGE_SIZE && !logging &&
+		      !(vma->vm_flags & VM_PFNMAP) && !is_vm_hugetlb_page(vma);
 
 	/*
 	 * Read mmu_invalidate_seq so that KVM can detect if the results of
@@ -669,6 +925,7 @@ int kvm_riscv_gstage_map(struct kvm_vcpu *vcpu,
 	mmap_read_unlock(current->mm);
 
 	if (vma_pagesize != PGDIR_SIZE &&
+	    vma_pagesize != PUD_SIZE &&
 	    vma_pagesize != PMD_SIZE &&
 	    vma_pagesize != PAGE_SIZE) {
 		kvm_err("Invalid VMA page size 0x%lx\n", vma_pagesize);
@@ -696,6 +953,10 @@ int kvm_riscv_gstage_map(struct kvm_vcpu *vcpu,
 	if (mmu_invalidate_retry(kvm, mmu_seq))
 		goto out_unlock;
 
+	if (thp_allowed)
+		vma_pagesize = transparent_hugepage_adjust(kvm, memslot, hva,
+							   &hfn, &gpa);
+
 	if (writable) {
 		kvm_set_pfn_dirty(hfn);
 		mark_page_dirty(kvm, gfn);
@@ -173,10 +173,15 @@ void kvm_riscv_local_tlb_sanitize(struct kvm_vcpu *vcpu)
 	 *
 	 * To cleanup stale TLB entries, we simply flush all G-stage TLB
 	 * entries by VMID whenever underlying Host CPU changes for a VCPU.
+	 * This can't be skipped based on G-stage invalidations alone: guest
+	 * sfence.vma and hfence.vvma are local to the Host CPU they ran on,
+	 * so a VCPU coming back to a CPU may find VS-stage entries its guest
+	 * has since fenced elsewhere.
 	 */
 
 	vmid = READ_ONCE(vcpu->kvm->arch.vmid.vmid);
 	kvm_riscv_local_hfence_gvma_vmid_all(vmid);
+	vcpu->kvm->stat.gstage_tlb_sanitize++;
 }
 
 void kvm_riscv_fence_i_process(struct kvm_vcpu *vcpu)
@@ -200,6 +205,56 @@ void kvm_riscv_hfence_vvma_all_process(struct kvm_vcpu *vcpu)
 	kvm_riscv_local_hfence_vvma_all(READ_ONCE(vmid->vmid));
 }
 
+/*
+ * Number of individual fence instructions needed to process an entry.
+ * The local helpers switch to a full flush beyond PTRS_PER_PTE of them,
+ * which is also what the enqueue side uses as its cost limit.
+ */
+static unsigned long hfence_cost(const struct kvm_riscv_hfence *d)
+{
+	if (d->type == KVM_RISCV_HFENCE_VVMA_ASID_ALL)
+		return 1;
+
+	return max_t(unsigned long, d->size >> d->order, 1);
+}
+
+/*
+ * Try to fold the new request into an entry that is still queued. All
+ * queued entries are processed before the VCPU next enters the guest, so
+ * the order in which they are issued does not matter.
+ */
+static bool hfence_merge(struct kvm_riscv_hfence *q,
+			 const struct kvm_riscv_hfence *d)
+{
+	gpa_t qend, dend;
+
+	if (q->asid != d->asid)
+		return false;
+
+	if (q->type == KVM_RISCV_HFENCE_VVMA_ASID_ALL)
+		return d->type == KVM_RISCV_HFENCE_VVMA_ASID_ALL ||
+		       d->type == KVM_RISCV_HFENCE_VVMA_ASID_GVA;
+
+	if (q->type == KVM_RISCV_HFENCE_VVMA_ASID_GVA &&
+	    d->type == KVM_RISCV_HFENCE_VVMA_ASID_ALL) {
+		*q = *d;
+		return true;
+	}
+
+	if (q->type != d->type)
+		return false;
+
+	qend = q->addr + q->size;
+	dend = d->addr + d->size;
+	if (d->addr > qend || q->addr > dend)
+		return false;
+
+	q->addr = min(q->addr, d->addr);
+	q->size = max(qend, dend) - q->addr;
+	q->order = min(q->order, d->order);
+	return true;
+}
+
 static bool vcpu_hfence_dequeue(struct kvm_vcpu *vcpu,
 				struct kvm_riscv_hfence *out_data)
 {
@@ -212,6 +267,8 @@ static bool vcpu_hfence_dequeue(struct kvm_vcpu *vcpu,
 		memcpy(out_data, &varch->hfence_queue[varch->hfence_head],
 		       sizeof(*out_data));
 		varch->hfence_queue[varch->hfence_head].type = 0;
+		varch->hfence_pending_pages -= min(hfence_cost(out_data),
+						   varch->hfence_pending_pages);
 
 		varch->hfence_head++;
 		if (varch->hfence_head == KVM_RISCV_VCPU_MAX_HFENCE)
@@ -229,21 +286,58 @@ static bool vcpu_hfence_enqueue(struct kvm_vcpu *vcpu,
 				const struct kvm_riscv_hfence *data)
 {
 	bool ret = false;
+	unsigned long i, idx, cost, old_cost;
 	struct kvm_vcpu_arch *varch = &vcpu->arch;
+	struct kvm_riscv_hfence *q;
+	/* Counted on the target VCPU, under its hfence_lock */
+	struct kvm_vcpu_stat *stat = &vcpu->stat;
 
 	spin_lock(&varch->hfence_lock);
 
-	if (!varch->hfence_queue[varch->hfence_tail].type) {
-		memcpy(&varch->hfence_queue[varch->hfence_tail],
-		       data, sizeof(*data));
+	/* Coalesce with one of the most recently queued entries */
+	idx = varch->hfence_tail;
+	for (i = 0; i < KVM_RISCV_HFENCE_MERGE_WINDOW; i++) {
+		idx = idx ? idx - 1 : KVM_RISCV_VCPU_MAX_HFENCE - 1;
+		q = &varch->hfence_queue[idx];
+		if (!q->type)
+			break;
 
-		varch->hfence_tail++;
-		if (varch->hfence_tail == KVM_RISCV_VCPU_MAX_HFENCE)
-			varch->hfence_tail = 0;
+		old_cost = hfence_cost(q);
+		if (!hfence_merge(q, data))
+			continue;
 
+		varch->hfence_pending_pages += hfence_cost(q) - old_cost;
+		stat->hfence_merged++;
 		ret = true;
+		goto out;
+	}
+
+	/*
+	 * Once the queue holds more single-page fences than a full flush
+	 * is worth, stop queueing and let the caller fall back to one.
+	 */
+	cost = hfence_cost(data);
+	if (varch->hfence_pending_pages + cost > PTRS_PER_PTE) {
+		stat->hfence_flush_all++;
+		goto out;
+	}
+
+	if (varch->hfence_queue[varch->hfence_tail].type) {
+		stat->hfence_overflow++;
+		goto out;
 	}
 
+	memcpy(&varch->hfence_queue[varch->hfence_tail], data, sizeof(*data));
+	varch->hfence_pending_pages += cost;
+
+	varch->hfence_tail++;
+	if (varch->hfence_tail == KVM_RISCV_VCPU_MAX_HFENCE)
+		varch->hfence_tail = 0;
+
+	stat->hfence_enqueued++;
+	ret = true;
+
+out:
 	spin_unlock(&varch->hfence_lock);
 
 	return ret;
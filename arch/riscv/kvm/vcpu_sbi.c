@@ -48,6 +48,8 @@ static const struct kvm_vcpu_sbi_extension *sbi_ext[] = {
 	&vcpu_sbi_ext_rfence,
 	&vcpu_sbi_ext_srst,
 	&vcpu_sbi_ext_hsm,
+	&vcpu_sbi_ext_sta,
+	&vcpu_sbi_ext_pv_yield,
 	&vcpu_sbi_ext_experimental,
 	&vcpu_sbi_ext_vendor,
 };
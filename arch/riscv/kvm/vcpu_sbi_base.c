@@ -21,6 +21,7 @@ static int kvm_sbi_ext_base_handler(struct kvm_vcpu *vcpu, struct kvm_run *run,
 {
 	int ret = 0;
 	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+	const struct kvm_vcpu_sbi_extension *sbi_ext;
 	struct sbiret ecall_ret;
 
 	switch (cp->a6) {
@@ -36,7 +37,10 @@ static int kvm_sbi_ext_base_handler(struct kvm_vcpu *vcpu, struct kvm_run *run,
 		*out_val = LINUX_VERSION_CODE;
 		break;
 	case SBI_EXT_BASE_PROBE_EXT:
-		if ((cp->a0 >= SBI_EXT_EXPERIMENTAL_START &&
+		if (cp->a0 == SBI_EXT_PV_YIELD) {
+			/* Handled in kernel despite the experimental range */
+			*out_val = 1;
+		} else if ((cp->a0 >= SBI_EXT_EXPERIMENTAL_START &&
 		     cp->a0 <= SBI_EXT_EXPERIMENTAL_END) ||
 		    (cp->a0 >= SBI_EXT_VENDOR_START &&
 		     cp->a0 <= SBI_EXT_VENDOR_END)) {
@@ -46,8 +50,15 @@ static int kvm_sbi_ext_base_handler(struct kvm_vcpu *vcpu, struct kvm_run *run,
 			 */
 			kvm_riscv_vcpu_sbi_forward(vcpu, run);
 			*exit = true;
-		} else
-			*out_val = kvm_vcpu_sbi_find_ext(cp->a0) ? 1 : 0;
+		} else {
+			sbi_ext = kvm_vcpu_sbi_find_ext(cp->a0);
+			if (!sbi_ext)
+				*out_val = 0;
+			else if (sbi_ext->probe)
+				*out_val = sbi_ext->probe(vcpu);
+			else
+				*out_val = 1;
+		}
 		break;
 	case SBI_EXT_BASE_GET_MVENDORID:
 	case SBI_EXT_BASE_GET_MARCHID:
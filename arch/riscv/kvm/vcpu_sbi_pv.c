@@ -0,0 +1,302 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Paravirtual SBI extensions: steal-time accounting (STA) and directed
+ * yield for guests spinning on a preempted vCPU.
+ */
+
+#include <linux/errno.h>
+#include <linux/err.h>
+#include <linux/kvm_host.h>
+#include <linux/sched/stat.h>
+#include <linux/uaccess.h>
+#include <asm/sbi.h>
+#include <asm/kvm_vcpu_sbi.h>
+
+void kvm_riscv_vcpu_sbi_sta_reset(struct kvm_vcpu *vcpu)
+{
+	vcpu->arch.sta.shmem = INVALID_GPA;
+	vcpu->arch.sta.last_steal = 0;
+}
+
+static u64 kvm_riscv_vcpu_run_delay(void)
+{
+#ifdef CONFIG_SCHED_INFO
+	return READ_ONCE(current->sched_info.run_delay);
+#else
+	return 0;
+#endif
+}
+
+static unsigned long kvm_riscv_vcpu_sta_hva(struct kvm_vcpu *vcpu,
+					    gpa_t shmem)
+{
+	unsigned long hva = kvm_vcpu_gfn_to_hva(vcpu, gpa_to_gfn(shmem));
+
+	if (kvm_is_error_hva(hva))
+		return hva;
+
+	return hva + offset_in_page(shmem);
+}
+
+/*
+ * Fold the time this vCPU thread spent runnable but not running since the
+ * last update into the guest record. The sequence counter is odd while the
+ * update is in progress so the guest can retry torn reads.
+ */
+void kvm_riscv_vcpu_record_steal_time(struct kvm_vcpu *vcpu)
+{
+	gpa_t shmem = vcpu->arch.sta.shmem;
+	u64 last_steal = vcpu->arch.sta.last_steal;
+	struct sbi_sta_struct __user *st;
+	__le32 sequence_le;
+	__le64 steal_le;
+	unsigned long hva;
+	u32 sequence;
+	u64 steal;
+
+	if (shmem == INVALID_GPA)
+		return;
+
+	hva = kvm_riscv_vcpu_sta_hva(vcpu, shmem);
+	if (WARN_ON(kvm_is_error_hva(hva))) {
+		vcpu->arch.sta.shmem = INVALID_GPA;
+		return;
+	}
+	st = (struct sbi_sta_struct __user *)hva;
+
+	if (WARN_ON(get_user(sequence_le, &st->sequence)))
+		return;
+
+	sequence = le32_to_cpu(sequence_le) + 1;
+	if (WARN_ON(put_user(cpu_to_le32(sequence), &st->sequence)))
+		return;
+
+	if (!WARN_ON(get_user(steal_le, &st->steal))) {
+		steal = le64_to_cpu(steal_le);
+		vcpu->arch.sta.last_steal = kvm_riscv_vcpu_run_delay();
+		steal += vcpu->arch.sta.last_steal - last_steal;
+		WARN_ON(put_user(cpu_to_le64(steal), &st->steal));
+	}
+	WARN_ON(put_user(0, &st->preempted));
+
+	sequence += 1;
+	WARN_ON(put_user(cpu_to_le32(sequence), &st->sequence));
+
+	kvm_vcpu_mark_page_dirty(vcpu, gpa_to_gfn(shmem));
+}
+
+/*
+ * Called from vcpu_put() when the vCPU thread is preempted while runnable.
+ * This runs with preemption disabled so the write must not fault.
+ */
+void kvm_riscv_vcpu_set_preempted(struct kvm_vcpu *vcpu)
+{
+	gpa_t shmem = vcpu->arch.sta.shmem;
+	struct sbi_sta_struct __user *st;
+	unsigned long hva;
+	u8 preempted = 1;
+	int idx;
+
+	if (shmem == INVALID_GPA)
+		return;
+
+	idx = srcu_read_lock(&vcpu->kvm->srcu);
+	hva = kvm_riscv_vcpu_sta_hva(vcpu, shmem);
+	if (!kvm_is_error_hva(hva)) {
+		st = (struct sbi_sta_struct __user *)hva;
+		if (!copy_to_user_nofault(&st->preempted, &preempted,
+					  sizeof(preempted)))
+			kvm_vcpu_mark_page_dirty(vcpu, gpa_to_gfn(shmem));
+	}
+	srcu_read_unlock(&vcpu->kvm->srcu, idx);
+}
+
+static int kvm_sbi_sta_steal_time_set_shmem(struct kvm_vcpu *vcpu)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+	unsigned long shmem_phys_lo = cp->a0;
+	unsigned long shmem_phys_hi = cp->a1;
+	u32 flags = cp->a2;
+	struct sbi_sta_struct zero_sta = {0};
+	unsigned long hva;
+	bool writable;
+	gpa_t shmem;
+	int ret;
+
+	if (flags != 0)
+		return -EINVAL;
+
+	if (shmem_phys_lo == SBI_SHMEM_DISABLE &&
+	    shmem_phys_hi == SBI_SHMEM_DISABLE) {
+		vcpu->arch.sta.shmem = INVALID_GPA;
+		return 0;
+	}
+
+	if (shmem_phys_lo & (sizeof(struct sbi_sta_struct) - 1))
+		return -EINVAL;
+
+	shmem = shmem_phys_lo;
+	if (shmem_phys_hi != 0) {
+		if (IS_ENABLED(CONFIG_32BIT))
+			shmem |= ((gpa_t)shmem_phys_hi << 32);
+		else
+			return -EFAULT;
+	}
+
+	hva = kvm_vcpu_gfn_to_hva_prot(vcpu, gpa_to_gfn(shmem), &writable);
+	if (kvm_is_error_hva(hva) || !writable)
+		return -EFAULT;
+
+	ret = kvm_vcpu_write_guest(vcpu, shmem, &zero_sta, sizeof(zero_sta));
+	if (ret)
+		return -EFAULT;
+
+	vcpu->arch.sta.shmem = shmem;
+	vcpu->arch.sta.last_steal = kvm_riscv_vcpu_run_delay();
+
+	return 0;
+}
+
+static int kvm_sbi_ext_sta_handler(struct kvm_vcpu *vcpu, struct kvm_run *run,
+				   unsigned long *out_val,
+				   struct kvm_cpu_trap *utrap, bool *exit)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+
+	/* Not probed as available in that case, see below */
+	if (!sched_info_on())
+		return -EOPNOTSUPP;
+
+	switch (cp->a6) {
+	case SBI_EXT_STA_STEAL_TIME_SET_SHMEM:
+		return kvm_sbi_sta_steal_time_set_shmem(vcpu);
+	}
+
+	return -EOPNOTSUPP;
+}
+
+/* Steal time is derived from the scheduler's run_delay */
+static unsigned long kvm_sbi_ext_sta_probe(struct kvm_vcpu *vcpu)
+{
+	return sched_info_on();
+}
+
+const struct kvm_vcpu_sbi_extension vcpu_sbi_ext_sta = {
+	.extid_start = SBI_EXT_STA,
+	.extid_end = SBI_EXT_STA,
+	.handler = kvm_sbi_ext_sta_handler,
+	.probe = kvm_sbi_ext_sta_probe,
+};
+
+/*
+ * The shared memory address is the only STA state, so that a migrated
+ * guest keeps its steal-time record without registering it again.
+ */
+int kvm_riscv_vcpu_get_reg_sbi_sta(struct kvm_vcpu *vcpu,
+				   const struct kvm_one_reg *reg)
+{
+	unsigned long __user *uaddr =
+			(unsigned long __user *)(unsigned long)reg->addr;
+	unsigned long reg_num = reg->id & ~(KVM_REG_ARCH_MASK |
+					    KVM_REG_SIZE_MASK |
+					    KVM_REG_RISCV_SBI_STA);
+	gpa_t shmem = vcpu->arch.sta.shmem;
+	unsigned long reg_val;
+
+	if (KVM_REG_SIZE(reg->id) != sizeof(unsigned long))
+		return -EINVAL;
+
+	switch (reg_num) {
+	case KVM_REG_RISCV_SBI_STA_REG(shmem_lo):
+		reg_val = (unsigned long)shmem;
+		break;
+	case KVM_REG_RISCV_SBI_STA_REG(shmem_hi):
+		if (IS_ENABLED(CONFIG_32BIT))
+			reg_val = upper_32_bits(shmem);
+		else
+			reg_val = 0;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (copy_to_user(uaddr, &reg_val, KVM_REG_SIZE(reg->id)))
+		return -EFAULT;
+
+	return 0;
+}
+
+int kvm_riscv_vcpu_set_reg_sbi_sta(struct kvm_vcpu *vcpu,
+				   const struct kvm_one_reg *reg)
+{
+	unsigned long __user *uaddr =
+			(unsigned long __user *)(unsigned long)reg->addr;
+	unsigned long reg_num = reg->id & ~(KVM_REG_ARCH_MASK |
+					    KVM_REG_SIZE_MASK |
+					    KVM_REG_RISCV_SBI_STA);
+	gpa_t shmem = vcpu->arch.sta.shmem;
+	unsigned long reg_val;
+
+	if (KVM_REG_SIZE(reg->id) != sizeof(unsigned long))
+		return -EINVAL;
+
+	if (copy_from_user(&reg_val, uaddr, KVM_REG_SIZE(reg->id)))
+		return -EFAULT;
+
+	switch (reg_num) {
+	case KVM_REG_RISCV_SBI_STA_REG(shmem_lo):
+		if (IS_ENABLED(CONFIG_32BIT))
+			shmem = ((gpa_t)upper_32_bits(shmem) << 32) | reg_val;
+		else
+			shmem = reg_val;
+		break;
+	case KVM_REG_RISCV_SBI_STA_REG(shmem_hi):
+		if (IS_ENABLED(CONFIG_32BIT))
+			shmem = ((gpa_t)reg_val << 32) | lower_32_bits(shmem);
+		else if (reg_val != 0)
+			return -EINVAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	vcpu->arch.sta.shmem = shmem;
+	/* Only steal time from here on is accounted to the new record */
+	vcpu->arch.sta.last_steal = kvm_riscv_vcpu_run_delay();
+
+	return 0;
+}
+
+static int kvm_sbi_ext_pv_yield_handler(struct kvm_vcpu *vcpu,
+					struct kvm_run *run,
+					unsigned long *out_val,
+					struct kvm_cpu_trap *utrap, bool *exit)
+{
+	struct kvm_cpu_context *cp = &vcpu->arch.guest_context;
+	unsigned long target_vcpuid = cp->a0;
+	struct kvm_vcpu *target;
+
+	if (cp->a6 != SBI_EXT_PV_YIELD_TO)
+		return -EOPNOTSUPP;
+
+	if (target_vcpuid == SBI_PV_YIELD_ANY) {
+		kvm_vcpu_on_spin(vcpu, false);
+		return 0;
+	}
+
+	target = kvm_get_vcpu_by_id(vcpu->kvm, target_vcpuid);
+	if (!target)
+		return -EINVAL;
+
+	/* Only worth giving up our slice to a vCPU that is not running */
+	if (target != vcpu && READ_ONCE(target->preempted))
+		*out_val = kvm_vcpu_yield_to(target) > 0;
+
+	return 0;
+}
+
+const struct kvm_vcpu_sbi_extension vcpu_sbi_ext_pv_yield = {
+	.extid_start = SBI_EXT_PV_YIELD,
+	.extid_end = SBI_EXT_PV_YIELD,
+	.handler = kvm_sbi_ext_pv_yield_handler,
+};
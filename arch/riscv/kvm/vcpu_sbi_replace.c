@@ -30,6 +30,7 @@ static int kvm_sbi_ext_time_handler(struct kvm_vcpu *vcpu, struct kvm_run *run,
 #else
 	next_cycle = (u64)cp->a0;
 #endif
+	vcpu->stat.timer_set_exits++;
 	kvm_riscv_vcpu_timer_next_event(vcpu, next_cycle);
 
 	return ret;
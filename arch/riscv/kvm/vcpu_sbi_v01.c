@@ -42,6 +42,7 @@ static int kvm_sbi_ext_v01_handler(struct kvm_vcpu *vcpu, struct kvm_run *run,
 #else
 		next_cycle = (u64)cp->a0;
 #endif
+		vcpu->stat.timer_set_exits++;
 		ret = kvm_riscv_vcpu_timer_next_event(vcpu, next_cycle);
 		break;
 	case SBI_EXT_0_1_CLEAR_IPI:
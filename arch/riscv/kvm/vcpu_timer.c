@@ -150,9 +150,16 @@ static void kvm_riscv_vcpu_timer_blocking(struct kvm_vcpu *vcpu)
 	if (!t->init_done)
 		return;
 
+	/* The guest has no timer armed so there is nothing to wake up for */
+	if (t->next_cycles == -1ULL) {
+		vcpu->stat.timer_hrtimer_avoided++;
+		return;
+	}
+
 	delta_ns = kvm_riscv_delta_cycles2ns(t->next_cycles, gt, t);
 	hrtimer_start(&t->hrt, ktime_set(0, delta_ns), HRTIMER_MODE_REL);
 	t->next_set = true;
+	vcpu->stat.timer_hrtimer_armed++;
 }
 
 static void kvm_riscv_vcpu_timer_unblocking(struct kvm_vcpu *vcpu)
@@ -160,6 +167,39 @@ static void kvm_riscv_vcpu_timer_unblocking(struct kvm_vcpu *vcpu)
 	kvm_riscv_vcpu_timer_cancel(&vcpu->arch.timer);
 }
 
+/*
+ * Called on a WFI exit before halting. When the guest timer fires within
+ * the halt-polling window, poll until the deadline instead of scheduling
+ * out, which would arm an hrtimer on put and cancel it again on load.
+ */
+void kvm_riscv_vcpu_timer_halt_poll(struct kvm_vcpu *vcpu)
+{
+	struct kvm_vcpu_timer *t = &vcpu->arch.timer;
+	struct kvm_guest_timer *gt = &vcpu->kvm->arch.timer;
+	struct kvm *kvm = vcpu->kvm;
+	unsigned int max_poll_ns;
+	u64 delta_ns;
+
+	if (!t->init_done || t->next_cycles == -1ULL)
+		return;
+
+	if (kvm->override_halt_poll_ns) {
+		/* Pairs with the smp_wmb() when enabling KVM_CAP_HALT_POLL */
+		smp_rmb();
+		max_poll_ns = READ_ONCE(kvm->max_halt_poll_ns);
+	} else {
+		max_poll_ns = READ_ONCE(halt_poll_ns);
+	}
+
+	delta_ns = kvm_riscv_delta_cycles2ns(t->next_cycles, gt, t);
+	if (!delta_ns || delta_ns > max_poll_ns ||
+	    delta_ns <= vcpu->halt_poll_ns)
+		return;
+
+	vcpu->halt_poll_ns = delta_ns;
+	vcpu->stat.wfi_timer_polls++;
+}
+
 int kvm_riscv_vcpu_get_reg_timer(struct kvm_vcpu *vcpu,
 				 const struct kvm_one_reg *reg)
 {
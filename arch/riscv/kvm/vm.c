@@ -13,7 +13,9 @@
 #include <linux/kvm_host.h>
 
 const struct _kvm_stats_desc kvm_vm_stats_desc[] = {
-	KVM_GENERIC_VM_STATS()
+	KVM_GENERIC_VM_STATS(),
+	STATS_DESC_COUNTER(VM, gstage_splits),
+	STATS_DESC_COUNTER(VM, gstage_tlb_sanitize)
 };
 static_assert(ARRAY_SIZE(kvm_vm_stats_desc) ==
 		sizeof(struct kvm_vm_stat) / sizeof(u64));
@@ -43,12 +45,16 @@ int kvm_arch_init_vm(struct kvm *kvm, unsigned long type)
 
 	kvm_riscv_guest_timer_init(kvm);
 
+	kvm->arch.split_page_cache.gfp_zero = __GFP_ZERO;
+
 	return 0;
 }
 
 void kvm_arch_destroy_vm(struct kvm *kvm)
 {
 	kvm_destroy_vcpus(kvm);
+
+	kvm_mmu_free_memory_cache(&kvm->arch.split_page_cache);
 }
 
 int kvm_vm_ioctl_check_extension(struct kvm *kvm, long ext)
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * XOR block functions using the vector 0.7.1 extension
+ */
+
+#include <linux/raid/xor.h>
+#include <linux/module.h>
+#include <asm/insn-def.h>
+
+/*
+ * All routines work on e8/m4 register groups: v0-v3 hold the destination,
+ * v4-v7 the source being folded in. The caller owns the vector unit.
+ */
+
+static void __xor_rvv_2(unsigned long bytes, unsigned long * __restrict p1,
+			const unsigned long * __restrict p2)
+{
+	u8 *d = (u8 *)p1;
+	const u8 *s1 = (const u8 *)p2;
+	unsigned long vl;
+
+	do {
+		asm volatile(VSETVLI_E8M4(%0, %1) : "=r" (vl) : "r" (bytes));
+		asm volatile(VLB_V(0, %0)
+			     VLB_V(4, %1)
+			     VXOR_VV(0, 0, 4)
+			     VSB_V(0, %0)
+			     : : "r" (d), "r" (s1) : "memory");
+		bytes -= vl;
+		d += vl;
+		s1 += vl;
+	} while (bytes);
+}
+
+static void __xor_rvv_3(unsigned long bytes, unsigned long * __restrict p1,
+			const unsigned long * __restrict p2,
+			const unsigned long * __restrict p3)
+{
+	u8 *d = (u8 *)p1;
+	const u8 *s1 = (const u8 *)p2;
+	const u8 *s2 = (const u8 *)p3;
+	unsigned long vl;
+
+	do {
+		asm volatile(VSETVLI_E8M4(%0, %1) : "=r" (vl) : "r" (bytes));
+		asm volatile(VLB_V(0, %0)
+			     VLB_V(4, %1)
+			     VXOR_VV(0, 0, 4)
+			     VLB_V(4, %2)
+			     VXOR_VV(0, 0, 4)
+			     VSB_V(0, %0)
+			     : : "r" (d), "r" (s1), "r" (s2) : "memory");
+		bytes -= vl;
+		d += vl;
+		s1 += vl;
+		s2 += vl;
+	} while (bytes);
+}
+
+static void __xor_rvv_4(unsigned long bytes, unsigned long * __restrict p1,
+			const unsigned long * __restrict p2,
+			const unsigned long * __restrict p3,
+			const unsigned long * __restrict p4)
+{
+	u8 *d = (u8 *)p1;
+	const u8 *s1 = (const u8 *)p2;
+	const u8 *s2 = (const u8 *)p3;
+	const u8 *s3 = (const u8 *)p4;
+	unsigned long vl;
+
+	do {
+		asm volatile(VSETVLI_E8M4(%0, %1) : "=r" (vl) : "r" (bytes));
+		asm volatile(VLB_V(0, %0)
+			     VLB_V(4, %1)
+			     VXOR_VV(0, 0, 4)
+			     VLB_V(4, %2)
+			     VXOR_VV(0, 0, 4)
+			     VLB_V(4, %3)
+			     VXOR_VV(0, 0, 4)
+			     VSB_V(0, %0)
+			     : : "r" (d), "r" (s1), "r" (s2), "r" (s3)
+			     : "memory");
+		bytes -= vl;
+		d += vl;
+		s1 += vl;
+		s2 += vl;
+		s3 += vl;
+	} while (bytes);
+}
+
+static void __xor_rvv_5(unsigned long bytes, unsigned long * __restrict p1,
+			const unsigned long * __restrict p2,
+			const unsigned long * __restrict p3,
+			const unsigned long * __restrict p4,
+			const unsigned long * __restrict p5)
+{
+	u8 *d = (u8 *)p1;
+	const u8 *s1 = (const u8 *)p2;
+	const u8 *s2 = (const u8 *)p3;
+	const u8 *s3 = (const u8 *)p4;
+	const u8 *s4 = (const u8 *)p5;
+	unsigned long vl;
+
+	do {
+		asm volatile(VSETVLI_E8M4(%0, %1) : "=r" (vl) : "r" (bytes));
+		asm volatile(VLB_V(0, %0)
+			     VLB_V(4, %1)
+			     VXOR_VV(0, 0, 4)
+			     VLB_V(4, %2)
+			     VXOR_VV(0, 0, 4)
+			     VLB_V(4, %3)
+			     VXOR_VV(0, 0, 4)
+			     VLB_V(4, %4)
+			     VXOR_VV(0, 0, 4)
+			     VSB_V(0, %0)
+			     : : "r" (d), "r" (s1), "r" (s2), "r" (s3), "r" (s4)
+			     : "memory");
+		bytes -= vl;
+		d += vl;
+		s1 += vl;
+		s2 += vl;
+		s3 += vl;
+		s4 += vl;
+	} while (bytes);
+}
+
+struct xor_block_template const xor_block_inner_rvv = {
+	.name	= "__inner_rvv__",
+	.do_2	= __xor_rvv_2,
+	.do_3	= __xor_rvv_3,
+	.do_4	= __xor_rvv_4,
+	.do_5	= __xor_rvv_5,
+};
+EXPORT_SYMBOL(xor_block_inner_rvv);
+
+MODULE_DESCRIPTION("RISC-V vector XOR Extensions");
+MODULE_LICENSE("GPL");
@@ -8,6 +8,7 @@
 
 #ifdef CONFIG_SMP
 
+#include <linux/sched/clock.h>
 #include <asm/sbi.h>
 
 static void ipi_remote_fence_i(void *info)
@@ -15,14 +16,33 @@ static void ipi_remote_fence_i(void *info)
 	return local_flush_icache_all();
 }
 
+static inline bool use_ipi_for_fence_i(void)
+{
+	if (!IS_ENABLED(CONFIG_RISCV_SBI))
+		return true;
+	/*
+	 * A cross call can't complete while the other harts spin with
+	 * interrupts disabled, e.g. parked in stop_machine() for text
+	 * patching.  The SBI fence is delivered by the firmware and still
+	 * gets through, so fall back to it there.
+	 */
+	return riscv_use_ipi_for_rfence() && !irqs_disabled();
+}
+
 void flush_icache_all(void)
 {
+	u64 t0;
+
 	local_flush_icache_all();
 
-	if (IS_ENABLED(CONFIG_RISCV_SBI))
-		sbi_remote_fence_i(NULL);
-	else
+	t0 = local_clock();
+	if (use_ipi_for_fence_i()) {
 		on_each_cpu(ipi_remote_fence_i, NULL, 1);
+		riscv_rfence_account(RISCV_RFENCE_IPI, t0);
+	} else {
+		sbi_remote_fence_i(NULL);
+		riscv_rfence_account(RISCV_RFENCE_SBI, t0);
+	}
 }
 EXPORT_SYMBOL(flush_icache_all);
 
@@ -40,6 +60,7 @@ void flush_icache_mm(struct mm_struct *mm, bool local)
 {
 	unsigned int cpu;
 	cpumask_t others, *mask;
+	u64 t0;
 
 	preempt_disable();
 
@@ -67,10 +88,14 @@ void flush_icache_mm(struct mm_struct *mm, bool local)
 		 * with flush_icache_deferred().
 		 */
 		smp_mb();
-	} else if (IS_ENABLED(CONFIG_RISCV_SBI)) {
-		sbi_remote_fence_i(&others);
-	} else {
+	} else if (use_ipi_for_fence_i()) {
+		t0 = local_clock();
 		on_each_cpu_mask(&others, ipi_remote_fence_i, NULL, 1);
+		riscv_rfence_account(RISCV_RFENCE_IPI, t0);
+	} else {
+		t0 = local_clock();
+		sbi_remote_fence_i(&others);
+		riscv_rfence_account(RISCV_RFENCE_SBI, t0);
 	}
 
 	preempt_enable();
@@ -95,6 +120,27 @@ void flush_icache_pte(pte_t pte)
 		set_bit(PG_dcache_clean, &page->flags);
 	}
 }
+
+/*
+ * flush_icache_pte() for @nr consecutive pages of one folio, starting with
+ * the page mapped by @pte: a single flush_icache_all() covers all of them.
+ */
+void flush_icache_ptes(pte_t pte, unsigned int nr)
+{
+	struct page *page = pte_page(pte);
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		if (!test_bit(PG_dcache_clean, &nth_page(page, i)->flags))
+			break;
+	}
+	if (i == nr)
+		return;
+
+	flush_icache_all();
+	for (; i < nr; i++)
+		set_bit(PG_dcache_clean, &nth_page(page, i)->flags);
+}
 #endif /* CONFIG_MMU */
 
 unsigned int riscv_cbom_block_size;
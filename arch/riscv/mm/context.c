@@ -7,6 +7,7 @@
 
 #include <linux/bitops.h>
 #include <linux/cpumask.h>
+#include <linux/debugfs.h>
 #include <linux/mm.h>
 #include <linux/percpu.h>
 #include <linux/slab.h>
@@ -43,6 +44,21 @@ static unsigned long *context_asid_map;
 static DEFINE_PER_CPU(atomic_long_t, active_context);
 static DEFINE_PER_CPU(unsigned long, reserved_context);
 
+enum asid_stat_item {
+	ASID_FAST_SWITCH,	/* switched without taking context_lock */
+	ASID_SLOW_SWITCH,	/* had to take context_lock */
+	ASID_LOCK_CONTENDED,	/* ... and somebody else was holding it */
+	ASID_REUSE,		/* kept the ASID from an older version */
+	ASID_ALLOC,		/* picked a fresh ASID from the bitmap */
+	ASID_ROLLOVER,		/* ran out of ASIDs and bumped the version */
+	ASID_DEFERRED_FLUSH,	/* local TLB flush owed by a rollover */
+	NR_ASID_STAT_ITEMS,
+};
+
+static DEFINE_PER_CPU(unsigned long [NR_ASID_STAT_ITEMS], asid_stats);
+
+#define asid_stat_inc(item)	this_cpu_inc(asid_stats[item])
+
 static bool check_update_reserved_context(unsigned long cntx,
 					  unsigned long newcntx)
 {
@@ -118,15 +134,19 @@ static unsigned long __new_context(struct mm_struct *mm)
 		 * If our current CONTEXT was active during a rollover, we
 		 * can continue to use it and this was just a false alarm.
 		 */
-		if (check_update_reserved_context(cntx, newcntx))
+		if (check_update_reserved_context(cntx, newcntx)) {
+			asid_stat_inc(ASID_REUSE);
 			return newcntx;
+		}
 
 		/*
 		 * We had a valid CONTEXT in a previous life, so try to
 		 * re-use it if possible.
 		 */
-		if (!__test_and_set_bit(cntx & asid_mask, context_asid_map))
+		if (!__test_and_set_bit(cntx & asid_mask, context_asid_map)) {
+			asid_stat_inc(ASID_REUSE);
 			return newcntx;
+		}
 	}
 
 	/*
@@ -139,6 +159,7 @@ static unsigned long __new_context(struct mm_struct *mm)
 
 	/* We're out of ASIDs, so increment current_version */
 	ver = atomic_long_add_return_relaxed(num_asids, &current_version);
+	asid_stat_inc(ASID_ROLLOVER);
 
 	/* Flush everything  */
 	__flush_context();
@@ -147,6 +168,7 @@ static unsigned long __new_context(struct mm_struct *mm)
 	asid = find_next_zero_bit(context_asid_map, num_asids, 1);
 
 set_asid:
+	asid_stat_inc(ASID_ALLOC);
 	__set_bit(asid, context_asid_map);
 	cur_idx = asid;
 	return asid | ver;
@@ -180,10 +202,16 @@ static void set_mm_asid(struct mm_struct *mm, unsigned int cpu)
 	if (old_active_cntx &&
 	    ((cntx & ~asid_mask) == atomic_long_read(&current_version)) &&
 	    atomic_long_cmpxchg_relaxed(&per_cpu(active_context, cpu),
-					old_active_cntx, cntx))
+					old_active_cntx, cntx)) {
+		asid_stat_inc(ASID_FAST_SWITCH);
 		goto switch_mm_fast;
+	}
 
-	raw_spin_lock_irqsave(&context_lock, flags);
+	asid_stat_inc(ASID_SLOW_SWITCH);
+	if (!raw_spin_trylock_irqsave(&context_lock, flags)) {
+		asid_stat_inc(ASID_LOCK_CONTENDED);
+		raw_spin_lock_irqsave(&context_lock, flags);
+	}
 
 	/* Check that our ASID belongs to the current_version. */
 	cntx = atomic_long_read(&mm->context.id);
@@ -192,8 +220,10 @@ static void set_mm_asid(struct mm_struct *mm, unsigned int cpu)
 		atomic_long_set(&mm->context.id, cntx);
 	}
 
-	if (cpumask_test_and_clear_cpu(cpu, &context_tlb_flush_pending))
+	if (cpumask_test_and_clear_cpu(cpu, &context_tlb_flush_pending)) {
+		asid_stat_inc(ASID_DEFERRED_FLUSH);
 		need_flush_tlb = true;
+	}
 
 	atomic_long_set(&per_cpu(active_context, cpu), cntx);
 
@@ -225,8 +255,13 @@ static inline void set_mm(struct mm_struct *prev,
 	 * the asid mechanism wouldn't flush TLB for every switch_mm for
 	 * performance. So when using asid, keep all CPUs footmarks in
 	 * cpumask() until mm reset.
+	 *
+	 * The bit is normally already set when running with ASIDs, so test
+	 * it first rather than bouncing the cacheline between every hart
+	 * that runs a thread of this mm.
 	 */
-	cpumask_set_cpu(cpu, mm_cpumask(next));
+	if (!cpumask_test_cpu(cpu, mm_cpumask(next)))
+		cpumask_set_cpu(cpu, mm_cpumask(next));
 	if (static_branch_unlikely(&use_asid_allocator)) {
 		set_mm_asid(next, cpu);
 	} else {
@@ -296,6 +331,46 @@ static int  __init init_asids(void)
 }
 early_initcall(init_asids);
 
+#ifdef CONFIG_DEBUG_FS
+static const char * const asid_stat_names[] = {
+	[ASID_FAST_SWITCH]	= "fast_switch",
+	[ASID_SLOW_SWITCH]	= "slow_switch",
+	[ASID_LOCK_CONTENDED]	= "lock_contended",
+	[ASID_REUSE]		= "reuse",
+	[ASID_ALLOC]		= "alloc",
+	[ASID_ROLLOVER]		= "rollover",
+	[ASID_DEFERRED_FLUSH]	= "deferred_flush",
+};
+
+static int asid_stats_show(struct seq_file *m, void *v)
+{
+	unsigned long sum;
+	unsigned int cpu, i;
+
+	seq_printf(m, "asid_bits: %lu\n", asid_bits);
+	seq_printf(m, "version: %lu\n",
+		   num_asids ? atomic_long_read(&current_version) / num_asids : 0);
+	for (i = 0; i < NR_ASID_STAT_ITEMS; i++) {
+		sum = 0;
+		for_each_possible_cpu(cpu)
+			sum += per_cpu(asid_stats, cpu)[i];
+		seq_printf(m, "%s: %lu\n", asid_stat_names[i], sum);
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(asid_stats);
+
+static int __init asid_stats_init(void)
+{
+	if (static_branch_unlikely(&use_asid_allocator))
+		debugfs_create_file("riscv_asid", 0400, NULL, NULL,
+				    &asid_stats_fops);
+	return 0;
+}
+late_initcall(asid_stats_init);
+#endif /* CONFIG_DEBUG_FS */
+
 #else
 static inline void set_mm(struct mm_struct *prev,
 			  struct mm_struct *next, unsigned int cpu)
@@ -8,10 +8,17 @@
 #include <linux/dma-direct.h>
 #include <linux/dma-map-ops.h>
 #include <linux/mm.h>
+#include <linux/scatterlist.h>
 #include <asm/cacheflush.h>
 
 static bool noncoherent_supported;
 
+enum dma_cmo {
+	DMA_CMO_NONE,
+	DMA_CMO_CLEAN,
+	DMA_CMO_FLUSH,
+};
+
 void arch_sync_dma_for_device(phys_addr_t paddr, size_t size,
 			      enum dma_data_direction dir)
 {
@@ -49,6 +56,106 @@ void arch_sync_dma_for_cpu(phys_addr_t paddr, size_t size,
 	}
 }
 
+static enum dma_cmo dma_cmo_for_device(enum dma_data_direction dir)
+{
+	switch (dir) {
+	case DMA_TO_DEVICE:
+	case DMA_FROM_DEVICE:
+		return DMA_CMO_CLEAN;
+	case DMA_BIDIRECTIONAL:
+		return DMA_CMO_FLUSH;
+	default:
+		return DMA_CMO_NONE;
+	}
+}
+
+static enum dma_cmo dma_cmo_for_cpu(enum dma_data_direction dir)
+{
+	switch (dir) {
+	case DMA_FROM_DEVICE:
+	case DMA_BIDIRECTIONAL:
+		return DMA_CMO_FLUSH;
+	default:
+		return DMA_CMO_NONE;
+	}
+}
+
+static void dma_cmo_range(enum dma_cmo op, phys_addr_t start, phys_addr_t end)
+{
+	void *vaddr = phys_to_virt(start);
+	size_t size = end - start;
+
+	if (op == DMA_CMO_CLEAN)
+		ALT_CMO_OP_VPA(clean, vaddr, start, size, riscv_cbom_block_size);
+	else
+		ALT_CMO_OP_VPA(flush, vaddr, start, size, riscv_cbom_block_size);
+}
+
+/*
+ * Walk a mapped scatterlist and merge physically contiguous or overlapping
+ * segments into a single run before issuing the cache operations, so each
+ * cache block is only touched once even when many small segments share it.
+ */
+static void dma_cmo_sg(struct device *dev, struct scatterlist *sgl, int nents,
+		       enum dma_cmo op)
+{
+	unsigned long line = riscv_cbom_block_size;
+	phys_addr_t start = 0, end = 0, done_start = 0, done_end = 0;
+	struct scatterlist *sg;
+	int i;
+
+	if (op == DMA_CMO_NONE)
+		return;
+
+	for_each_sg(sgl, sg, nents, i) {
+		phys_addr_t paddr, s, e;
+
+		if (sg_is_dma_bus_address(sg) || !sg_dma_len(sg))
+			continue;
+
+		paddr = dma_to_phys(dev, sg_dma_address(sg));
+		s = ALIGN_DOWN(paddr, line);
+		e = ALIGN(paddr + sg_dma_len(sg), line);
+
+		if (end && s <= end && e >= start) {
+			start = min(start, s);
+			end = max(end, e);
+			continue;
+		}
+
+		if (end) {
+			dma_cmo_range(op, start, end);
+			done_start = start;
+			done_end = end;
+		}
+
+		/* Don't redo the tail of the run that was just issued */
+		if (s >= done_start && s < done_end)
+			s = done_end;
+		if (e <= s) {
+			start = end = 0;
+			continue;
+		}
+		start = s;
+		end = e;
+	}
+
+	if (end)
+		dma_cmo_range(op, start, end);
+}
+
+void arch_sync_dma_sg_for_device(struct device *dev, struct scatterlist *sgl,
+				 int nents, enum dma_data_direction dir)
+{
+	dma_cmo_sg(dev, sgl, nents, dma_cmo_for_device(dir));
+}
+
+void arch_sync_dma_sg_for_cpu(struct device *dev, struct scatterlist *sgl,
+			      int nents, enum dma_data_direction dir)
+{
+	dma_cmo_sg(dev, sgl, nents, dma_cmo_for_cpu(dir));
+}
+
 void arch_dma_prep_coherent(struct page *page, size_t size)
 {
 	void *flush_addr = page_address(page);
@@ -797,6 +797,13 @@ void __init create_pgd_mapping(pgd_t *pgdp,
 
 static uintptr_t __init best_map_size(phys_addr_t base, phys_addr_t size)
 {
+	/*
+	 * __kernel_map_pages() flips single pages of the linear map, also
+	 * from atomic context where blocks can't be split, see pageattr.c.
+	 */
+	if (debug_pagealloc_enabled())
+		return PAGE_SIZE;
+
 	/* Upgrade to PMD_SIZE mappings whenever possible */
 	if ((base & (PMD_SIZE - 1)) || (size & (PMD_SIZE - 1)))
 		return PAGE_SIZE;
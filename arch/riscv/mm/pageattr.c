@@ -3,8 +3,11 @@
  * Copyright (C) 2019 SiFive
  */
 
+#include <linux/debugfs.h>
+#include <linux/mm.h>
 #include <linux/pagewalk.h>
 #include <linux/pgtable.h>
+#include <linux/seq_file.h>
 #include <asm/tlbflush.h>
 #include <asm/bitops.h>
 #include <asm/set_memory.h>
@@ -14,6 +17,14 @@ struct pageattr_masks {
 	pgprot_t clear_mask;
 };
 
+/* Block mappings split and re-formed, protected by the init_mm mmap lock */
+static struct {
+	unsigned long pud_splits;
+	unsigned long pmd_splits;
+	unsigned long pud_merges;
+	unsigned long pmd_merges;
+} direct_map_stats;
+
 static unsigned long set_pageattr_masks(unsigned long val, struct mm_walk *walk)
 {
 	struct pageattr_masks *masks = walk->private;
@@ -104,6 +115,277 @@ static const struct mm_walk_ops pageattr_ops = {
 	.pte_hole = pageattr_pte_hole,
 };
 
+static unsigned long leaf_flags(unsigned long val)
+{
+	return val & ~_PAGE_PFN_MASK;
+}
+
+/*
+ * Blocks that [vaddr, end) only partially covers are split into the next
+ * level down, so that the attribute walk below only ever changes whole
+ * leaves that lie inside the range.
+ */
+static int split_pmd_range(pud_t *pudp, unsigned long vaddr,
+			   unsigned long end)
+{
+	unsigned long next;
+	pmd_t *pmdp;
+
+	pmdp = pmd_offset(pudp, vaddr);
+	do {
+		pmd_t pmd = READ_ONCE(*pmdp);
+		unsigned long pfn, flags;
+		pte_t *ptep;
+		int i;
+
+		next = pmd_addr_end(vaddr, end);
+		if (!pmd_leaf(pmd) ||
+		    (IS_ALIGNED(vaddr, PMD_SIZE) && next - vaddr == PMD_SIZE))
+			continue;
+
+		ptep = (pte_t *)get_zeroed_page(GFP_KERNEL);
+		if (!ptep)
+			return -ENOMEM;
+
+		pfn = _pmd_pfn(pmd);
+		flags = leaf_flags(pmd_val(pmd));
+		for (i = 0; i < PTRS_PER_PTE; i++)
+			set_pte(ptep + i, pfn_pte(pfn + i, __pgprot(flags)));
+
+		/* Make the new table visible before it is linked in */
+		smp_wmb();
+		set_pmd(pmdp, pfn_pmd(virt_to_pfn(ptep), PAGE_TABLE));
+		direct_map_stats.pmd_splits++;
+	} while (pmdp++, vaddr = next, vaddr != end);
+
+	return 0;
+}
+
+#ifdef CONFIG_64BIT
+/*
+ * On Sv39 the pud is folded into the pgd, and every process pgd holds its
+ * own copy of the kernel entries taken at pgd_alloc() time.  Changing one
+ * of those entries in init_mm alone would not reach the other mms, so 1G
+ * blocks are only split and merged when the pud level is a real table
+ * shared by all of them.  The linear map is never created with 1G blocks,
+ * so on Sv39 none exist to split.
+ */
+static int split_pud_leaf(pud_t *pudp, pud_t pud)
+{
+	unsigned long pfn, flags;
+	pmd_t *pmdp;
+	int i;
+
+	if (WARN_ON_ONCE(!pgtable_l4_enabled))
+		return -EINVAL;
+
+	pmdp = (pmd_t *)get_zeroed_page(GFP_KERNEL);
+	if (!pmdp)
+		return -ENOMEM;
+
+	pfn = _pud_pfn(pud);
+	flags = leaf_flags(pud_val(pud));
+	for (i = 0; i < PTRS_PER_PMD; i++)
+		set_pmd(pmdp + i, pfn_pmd(pfn + i * PTRS_PER_PTE,
+					  __pgprot(flags)));
+
+	smp_wmb();
+	set_pud(pudp, pfn_pud(virt_to_pfn(pmdp), PAGE_TABLE));
+	direct_map_stats.pud_splits++;
+
+	return 0;
+}
+#else
+static int split_pud_leaf(pud_t *pudp, pud_t pud)
+{
+	return 0;
+}
+#endif
+
+static int split_pud_range(p4d_t *p4dp, unsigned long vaddr,
+			   unsigned long end)
+{
+	unsigned long next;
+	pud_t *pudp;
+	int ret;
+
+	pudp = pud_offset(p4dp, vaddr);
+	do {
+		pud_t pud = READ_ONCE(*pudp);
+
+		next = pud_addr_end(vaddr, end);
+		if (!pud_present(pud))
+			continue;
+
+		if (pud_leaf(pud)) {
+			if (IS_ALIGNED(vaddr, PUD_SIZE) &&
+			    next - vaddr == PUD_SIZE)
+				continue;
+
+			ret = split_pud_leaf(pudp, pud);
+			if (ret)
+				return ret;
+		}
+
+		ret = split_pmd_range(pudp, vaddr, next);
+		if (ret)
+			return ret;
+	} while (pudp++, vaddr = next, vaddr != end);
+
+	return 0;
+}
+
+static int split_kernel_mapping(unsigned long vaddr, unsigned long end)
+{
+	unsigned long next;
+	pgd_t *pgdp;
+	int ret;
+
+	pgdp = pgd_offset_k(vaddr);
+	do {
+		p4d_t *p4dp;
+
+		next = pgd_addr_end(vaddr, end);
+		if (!pgd_present(READ_ONCE(*pgdp)))
+			continue;
+
+		p4dp = p4d_offset(pgdp, vaddr);
+		if (!p4d_present(READ_ONCE(*p4dp)))
+			continue;
+
+		ret = split_pud_range(p4dp, vaddr, next);
+		if (ret)
+			return ret;
+	} while (pgdp++, vaddr = next, vaddr != end);
+
+	return 0;
+}
+
+static void free_table_page(void *table)
+{
+	struct page *page = virt_to_page(table);
+
+	/* The boot page tables come from memblock */
+	if (PageReserved(page))
+		free_reserved_page(page);
+	else
+		free_page((unsigned long)table);
+}
+
+/* A pte table that maps a naturally aligned block with uniform attributes */
+static bool pte_table_mergeable(pte_t *ptep, unsigned long *pfn,
+				unsigned long *flags)
+{
+	pte_t first = READ_ONCE(ptep[0]);
+	int i;
+
+	if (!pte_present(first))
+		return false;
+
+	*pfn = pte_pfn(first);
+	*flags = leaf_flags(pte_val(first));
+	if (!IS_ALIGNED(*pfn, PTRS_PER_PTE))
+		return false;
+
+	for (i = 1; i < PTRS_PER_PTE; i++) {
+		pte_t pte = READ_ONCE(ptep[i]);
+
+		if (pte_pfn(pte) != *pfn + i ||
+		    leaf_flags(pte_val(pte)) != *flags)
+			return false;
+	}
+
+	return true;
+}
+
+#ifdef CONFIG_64BIT
+static bool merge_pmd_table(pud_t *pudp, pmd_t *pmdp)
+{
+	unsigned long pfn, flags;
+	pmd_t first = READ_ONCE(pmdp[0]);
+	int i;
+
+	/* see split_pud_leaf() */
+	if (!pgtable_l4_enabled || !pmd_leaf(first))
+		return false;
+
+	pfn = _pmd_pfn(first);
+	flags = leaf_flags(pmd_val(first));
+	if (!IS_ALIGNED(pfn, PTRS_PER_PMD * PTRS_PER_PTE))
+		return false;
+
+	for (i = 1; i < PTRS_PER_PMD; i++) {
+		pmd_t pmd = READ_ONCE(pmdp[i]);
+
+		if (!pmd_leaf(pmd) || _pmd_pfn(pmd) != pfn + i * PTRS_PER_PTE ||
+		    leaf_flags(pmd_val(pmd)) != flags)
+			return false;
+	}
+
+	set_pud(pudp, pfn_pud(pfn, __pgprot(flags)));
+	direct_map_stats.pud_merges++;
+
+	return true;
+}
+#else
+static bool merge_pmd_table(pud_t *pudp, pmd_t *pmdp)
+{
+	return false;
+}
+#endif
+
+/*
+ * Once a range of the linear map is back to uniform attributes (typically
+ * set_memory_rw() undoing an earlier set_memory_ro()), fold the tables
+ * covering it back into 2M and 1G blocks. The freed tables are queued on
+ * @tables and only released after the TLB flush.
+ */
+static void merge_linear_mapping(unsigned long start, unsigned long end,
+				 struct list_head *tables)
+{
+	unsigned long vaddr, pfn, flags;
+
+	for (vaddr = start & PUD_MASK; vaddr < end; vaddr += PUD_SIZE) {
+		pgd_t *pgdp = pgd_offset_k(vaddr);
+		p4d_t *p4dp;
+		pud_t *pudp;
+		pmd_t *pmdp;
+		int i;
+
+		if (!pgd_present(READ_ONCE(*pgdp)))
+			continue;
+		p4dp = p4d_offset(pgdp, vaddr);
+		if (!p4d_present(READ_ONCE(*p4dp)))
+			continue;
+		pudp = pud_offset(p4dp, vaddr);
+		if (!pud_present(READ_ONCE(*pudp)) || pud_leaf(READ_ONCE(*pudp)))
+			continue;
+
+		pmdp = pmd_offset(pudp, vaddr);
+		for (i = 0; i < PTRS_PER_PMD; i++) {
+			unsigned long addr = vaddr + i * PMD_SIZE;
+			pmd_t pmd = READ_ONCE(pmdp[i]);
+			pte_t *ptep;
+
+			if (addr + PMD_SIZE <= start || addr >= end ||
+			    !pmd_present(pmd) || pmd_leaf(pmd) ||
+			    !is_linear_mapping(addr))
+				continue;
+
+			ptep = (pte_t *)pmd_page_vaddr(pmd);
+			if (!pte_table_mergeable(ptep, &pfn, &flags))
+				continue;
+
+			set_pmd(&pmdp[i], pfn_pmd(pfn, __pgprot(flags)));
+			list_add(&virt_to_page(ptep)->lru, tables);
+			direct_map_stats.pmd_merges++;
+		}
+
+		if (is_linear_mapping(vaddr) && merge_pmd_table(pudp, pmdp))
+			list_add(&virt_to_page(pmdp)->lru, tables);
+	}
+}
+
 static int __set_memory(unsigned long addr, int numpages, pgprot_t set_mask,
 			pgprot_t clear_mask)
 {
@@ -114,16 +396,31 @@ static int __set_memory(unsigned long addr, int numpages, pgprot_t set_mask,
 		.set_mask = set_mask,
 		.clear_mask = clear_mask
 	};
+	struct page *page, *tmp;
+	LIST_HEAD(tables);
 
 	if (!numpages)
 		return 0;
 
 	mmap_write_lock(&init_mm);
-	ret =  walk_page_range_novma(&init_mm, start, end, &pageattr_ops, NULL,
-				     &masks);
+	ret = split_kernel_mapping(start, end);
+	if (!ret)
+		ret = walk_page_range_novma(&init_mm, start, end, &pageattr_ops,
+					    NULL, &masks);
+	if (!ret && is_linear_mapping(start) && !debug_pagealloc_enabled())
+		merge_linear_mapping(start, end, &tables);
 	mmap_write_unlock(&init_mm);
 
-	flush_tlb_kernel_range(start, end);
+	if (list_empty(&tables)) {
+		flush_tlb_kernel_range(start, end);
+	} else {
+		/* The merged blocks extend beyond the range */
+		flush_tlb_all();
+		list_for_each_entry_safe(page, tmp, &tables, lru) {
+			list_del(&page->lru);
+			free_table_page(page_address(page));
+		}
+	}
 
 	return ret;
 }
@@ -166,9 +463,12 @@ int set_direct_map_invalid_noflush(struct page *page)
 		.clear_mask = __pgprot(_PAGE_PRESENT)
 	};
 
-	mmap_read_lock(&init_mm);
-	ret = walk_page_range(&init_mm, start, end, &pageattr_ops, &masks);
-	mmap_read_unlock(&init_mm);
+	mmap_write_lock(&init_mm);
+	ret = split_kernel_mapping(start, end);
+	if (!ret)
+		ret = walk_page_range(&init_mm, start, end, &pageattr_ops,
+				      &masks);
+	mmap_write_unlock(&init_mm);
 
 	return ret;
 }
@@ -183,25 +483,50 @@ int set_direct_map_default_noflush(struct page *page)
 		.clear_mask = __pgprot(0)
 	};
 
-	mmap_read_lock(&init_mm);
-	ret = walk_page_range(&init_mm, start, end, &pageattr_ops, &masks);
-	mmap_read_unlock(&init_mm);
+	mmap_write_lock(&init_mm);
+	ret = split_kernel_mapping(start, end);
+	if (!ret)
+		ret = walk_page_range(&init_mm, start, end, &pageattr_ops,
+				      &masks);
+	mmap_write_unlock(&init_mm);
 
 	return ret;
 }
 
 #ifdef CONFIG_DEBUG_PAGEALLOC
+static int debug_pagealloc_set_page(pte_t *pte, unsigned long addr, void *data)
+{
+	int enable = *(int *)data;
+	unsigned long val = pte_val(READ_ONCE(*pte));
+
+	if (enable)
+		val |= _PAGE_PRESENT;
+	else
+		val &= ~_PAGE_PRESENT;
+
+	set_pte(pte, __pte(val));
+
+	return 0;
+}
+
+/*
+ * This runs from within the page allocator, possibly in atomic context, so
+ * it must neither take the init_mm mmap lock nor allocate page tables: the
+ * linear map is created with 4K pages when debug_pagealloc is enabled, and
+ * only the existing ptes are updated here.
+ */
 void __kernel_map_pages(struct page *page, int numpages, int enable)
 {
+	unsigned long start = (unsigned long)page_address(page);
+	unsigned long size = PAGE_SIZE * numpages;
+
 	if (!debug_pagealloc_enabled())
 		return;
 
-	if (enable)
-		__set_memory((unsigned long)page_address(page), numpages,
-			     __pgprot(_PAGE_PRESENT), __pgprot(0));
-	else
-		__set_memory((unsigned long)page_address(page), numpages,
-			     __pgprot(0), __pgprot(_PAGE_PRESENT));
+	apply_to_existing_page_range(&init_mm, start, size,
+				     debug_pagealloc_set_page, &enable);
+
+	flush_tlb_kernel_range(start, start + size);
 }
 #endif
 
@@ -241,3 +566,76 @@ bool kernel_page_present(struct page *page)
 	pte = pte_offset_kernel(pmd, addr);
 	return pte_present(*pte);
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int direct_map_show(struct seq_file *m, void *v)
+{
+	unsigned long vaddr = PAGE_OFFSET, end = (unsigned long)high_memory;
+	unsigned long nr_pud = 0, nr_pmd = 0, nr_pte = 0;
+
+	mmap_read_lock(&init_mm);
+	while (vaddr < end) {
+		pgd_t *pgdp = pgd_offset_k(vaddr);
+		p4d_t *p4dp;
+		pud_t *pudp;
+		pmd_t *pmdp;
+		pte_t *ptep;
+
+		if (!pgd_present(READ_ONCE(*pgdp))) {
+			vaddr = pgd_addr_end(vaddr, end);
+			continue;
+		}
+		p4dp = p4d_offset(pgdp, vaddr);
+		if (!p4d_present(READ_ONCE(*p4dp))) {
+			vaddr = p4d_addr_end(vaddr, end);
+			continue;
+		}
+		pudp = pud_offset(p4dp, vaddr);
+		if (!pud_present(READ_ONCE(*pudp))) {
+			vaddr = pud_addr_end(vaddr, end);
+			continue;
+		}
+		if (pud_leaf(READ_ONCE(*pudp))) {
+			nr_pud++;
+			vaddr = pud_addr_end(vaddr, end);
+			continue;
+		}
+		pmdp = pmd_offset(pudp, vaddr);
+		if (!pmd_present(READ_ONCE(*pmdp))) {
+			vaddr = pmd_addr_end(vaddr, end);
+			continue;
+		}
+		if (pmd_leaf(READ_ONCE(*pmdp))) {
+			nr_pmd++;
+			vaddr = pmd_addr_end(vaddr, end);
+			continue;
+		}
+		ptep = pte_offset_kernel(pmdp, vaddr);
+		if (pte_present(READ_ONCE(*ptep)))
+			nr_pte++;
+		vaddr += PAGE_SIZE;
+	}
+	mmap_read_unlock(&init_mm);
+
+	seq_printf(m, "DirectMap4k:\t%8lu kB\n", nr_pte << (PAGE_SHIFT - 10));
+	seq_printf(m, "DirectMap2M:\t%8lu kB\n", nr_pmd << (PMD_SHIFT - 10));
+	if (IS_ENABLED(CONFIG_64BIT))
+		seq_printf(m, "DirectMap1G:\t%8lu kB\n",
+			   nr_pud << (PUD_SHIFT - 10));
+	seq_printf(m, "pud_splits:\t%lu\n", direct_map_stats.pud_splits);
+	seq_printf(m, "pmd_splits:\t%lu\n", direct_map_stats.pmd_splits);
+	seq_printf(m, "pud_merges:\t%lu\n", direct_map_stats.pud_merges);
+	seq_printf(m, "pmd_merges:\t%lu\n", direct_map_stats.pmd_merges);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(direct_map);
+
+static int __init direct_map_debugfs_init(void)
+{
+	debugfs_create_file("riscv_direct_map", 0400, NULL, NULL,
+			    &direct_map_fops);
+	return 0;
+}
+late_initcall(direct_map_debugfs_init);
+#endif
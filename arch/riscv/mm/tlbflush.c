@@ -3,9 +3,17 @@
 #include <linux/mm.h>
 #include <linux/smp.h>
 #include <linux/sched.h>
+#include <linux/sched/clock.h>
 #include <asm/sbi.h>
 #include <asm/mmu_context.h>
 
+/*
+ * Flush entire TLB if number of entries to be flushed is greater
+ * than the threshold below. Walking a large range page by page with
+ * sfence.vma is slower than simply dropping the whole ASID.
+ */
+static unsigned long tlb_flush_all_threshold __read_mostly = 64;
+
 static inline void local_flush_tlb_all_asid(unsigned long asid)
 {
 	__asm__ __volatile__ ("sfence.vma x0, %0"
@@ -23,17 +31,87 @@ static inline void local_flush_tlb_page_asid(unsigned long addr,
 			: "memory");
 }
 
-void flush_tlb_all(void)
+static void local_flush_tlb_range_threshold_asid(unsigned long start,
+						 unsigned long size,
+						 unsigned long stride,
+						 unsigned long asid)
+{
+	unsigned long nr_ptes_in_range = DIV_ROUND_UP(size, stride);
+	int i;
+
+	if (nr_ptes_in_range > tlb_flush_all_threshold) {
+		local_flush_tlb_all_asid(asid);
+		return;
+	}
+
+	for (i = 0; i < nr_ptes_in_range; ++i) {
+		local_flush_tlb_page_asid(start, asid);
+		start += stride;
+	}
+}
+
+static void local_flush_tlb_range_threshold(unsigned long start,
+					    unsigned long size,
+					    unsigned long stride)
+{
+	unsigned long nr_ptes_in_range = DIV_ROUND_UP(size, stride);
+	int i;
+
+	if (nr_ptes_in_range > tlb_flush_all_threshold) {
+		local_flush_tlb_all();
+		return;
+	}
+
+	for (i = 0; i < nr_ptes_in_range; ++i) {
+		local_flush_tlb_page(start);
+		start += stride;
+	}
+}
+
+static inline void local_flush_tlb_range_asid(unsigned long start,
+		unsigned long size, unsigned long stride, unsigned long asid)
+{
+	if (size <= stride) {
+		if (asid == FLUSH_TLB_NO_ASID)
+			local_flush_tlb_page(start);
+		else
+			local_flush_tlb_page_asid(start, asid);
+	} else if (size == FLUSH_TLB_MAX_SIZE) {
+		if (asid == FLUSH_TLB_NO_ASID)
+			local_flush_tlb_all();
+		else
+			local_flush_tlb_all_asid(asid);
+	} else {
+		if (asid == FLUSH_TLB_NO_ASID)
+			local_flush_tlb_range_threshold(start, size, stride);
+		else
+			local_flush_tlb_range_threshold_asid(start, size,
+							     stride, asid);
+	}
+}
+
+struct flush_tlb_range_data {
+	unsigned long asid;
+	unsigned long start;
+	unsigned long size;
+	unsigned long stride;
+};
+
+static void __ipi_flush_tlb_range_asid(void *info)
 {
-	sbi_remote_sfence_vma(NULL, 0, -1);
+	struct flush_tlb_range_data *d = info;
+
+	local_flush_tlb_range_asid(d->start, d->size, d->stride, d->asid);
 }
 
-static void __sbi_tlb_flush_range(struct mm_struct *mm, unsigned long start,
-				  unsigned long size, unsigned long stride)
+static void __flush_tlb_range(const struct cpumask *cmask, unsigned long asid,
+			      unsigned long start, unsigned long size,
+			      unsigned long stride)
 {
-	struct cpumask *cmask = mm_cpumask(mm);
+	struct flush_tlb_range_data ftd;
 	unsigned int cpuid;
 	bool broadcast;
+	u64 t0;
 
 	if (cpumask_empty(cmask))
 		return;
@@ -41,48 +119,97 @@ static void __sbi_tlb_flush_range(struct mm_struct *mm, unsigned long start,
 	cpuid = get_cpu();
 	/* check if the tlbflush needs to be sent to other CPUs */
 	broadcast = cpumask_any_but(cmask, cpuid) < nr_cpu_ids;
-	if (static_branch_unlikely(&use_asid_allocator)) {
-		unsigned long asid = atomic_long_read(&mm->context.id) & asid_mask;
 
-		if (broadcast) {
-			sbi_remote_sfence_vma_asid(cmask, start, size, asid);
-		} else if (size <= stride) {
-			local_flush_tlb_page_asid(start, asid);
-		} else {
-			local_flush_tlb_all_asid(asid);
-		}
+	if (!broadcast) {
+		local_flush_tlb_range_asid(start, size, stride, asid);
+		goto out;
+	}
+
+	t0 = local_clock();
+	if (riscv_use_ipi_for_rfence() && !irqs_disabled()) {
+		/*
+		 * The IPI controller is reachable from S-mode, so a cross
+		 * call doing a local sfence.vma on each target hart is
+		 * cheaper than trapping into the firmware. The descriptor
+		 * may live on our stack since we wait for every target.
+		 * With interrupts disabled the cross call could deadlock
+		 * against harts spinning the same way (see
+		 * flush_icache_all()), so let the firmware deliver it then.
+		 */
+		ftd.asid = asid;
+		ftd.start = start;
+		ftd.size = size;
+		ftd.stride = stride;
+		on_each_cpu_mask(cmask, __ipi_flush_tlb_range_asid, &ftd, 1);
+		riscv_rfence_account(RISCV_RFENCE_IPI, t0);
 	} else {
-		if (broadcast) {
+		if (asid != FLUSH_TLB_NO_ASID)
+			sbi_remote_sfence_vma_asid(cmask, start, size, asid);
+		else
 			sbi_remote_sfence_vma(cmask, start, size);
-		} else if (size <= stride) {
-			local_flush_tlb_page(start);
-		} else {
-			local_flush_tlb_all();
-		}
+		riscv_rfence_account(RISCV_RFENCE_SBI, t0);
 	}
 
+out:
 	put_cpu();
 }
 
+void flush_tlb_all(void)
+{
+	__flush_tlb_range(cpu_online_mask, FLUSH_TLB_NO_ASID,
+			  0, FLUSH_TLB_MAX_SIZE, PAGE_SIZE);
+}
+
+static inline unsigned long get_mm_asid(struct mm_struct *mm)
+{
+	return static_branch_unlikely(&use_asid_allocator) ?
+			atomic_long_read(&mm->context.id) & asid_mask :
+			FLUSH_TLB_NO_ASID;
+}
+
 void flush_tlb_mm(struct mm_struct *mm)
 {
-	__sbi_tlb_flush_range(mm, 0, -1, PAGE_SIZE);
+	__flush_tlb_range(mm_cpumask(mm), get_mm_asid(mm),
+			  0, FLUSH_TLB_MAX_SIZE, PAGE_SIZE);
+}
+
+void flush_tlb_mm_range(struct mm_struct *mm, unsigned long start,
+			unsigned long end, unsigned int page_size)
+{
+	__flush_tlb_range(mm_cpumask(mm), get_mm_asid(mm),
+			  start, end - start, page_size);
 }
 
 void flush_tlb_page(struct vm_area_struct *vma, unsigned long addr)
 {
-	__sbi_tlb_flush_range(vma->vm_mm, addr, PAGE_SIZE, PAGE_SIZE);
+	__flush_tlb_range(mm_cpumask(vma->vm_mm), get_mm_asid(vma->vm_mm),
+			  addr, PAGE_SIZE, PAGE_SIZE);
 }
 
 void flush_tlb_range(struct vm_area_struct *vma, unsigned long start,
 		     unsigned long end)
 {
-	__sbi_tlb_flush_range(vma->vm_mm, start, end - start, PAGE_SIZE);
+	__flush_tlb_range(mm_cpumask(vma->vm_mm), get_mm_asid(vma->vm_mm),
+			  start, end - start, PAGE_SIZE);
 }
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 void flush_pmd_tlb_range(struct vm_area_struct *vma, unsigned long start,
 			unsigned long end)
 {
-	__sbi_tlb_flush_range(vma->vm_mm, start, end - start, PMD_SIZE);
+	__flush_tlb_range(mm_cpumask(vma->vm_mm), get_mm_asid(vma->vm_mm),
+			  start, end - start, PMD_SIZE);
 }
 #endif
+
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+void arch_tlbbatch_flush(struct arch_tlbflush_unmap_batch *batch)
+{
+	/*
+	 * The batch may span several mms with different ASIDs, so drop
+	 * everything non-global on the harts that ever ran one of them.
+	 */
+	__flush_tlb_range(&batch->cpumask, FLUSH_TLB_NO_ASID,
+			  0, FLUSH_TLB_MAX_SIZE, PAGE_SIZE);
+	cpumask_clear(&batch->cpumask);
+}
+#endif /* CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH */
@@ -365,18 +365,17 @@ int __weak populate_cache_leaves(unsigned int cpu)
 	return -ENOENT;
 }
 
-int detect_cache_attributes(unsigned int cpu)
+/*
+ * Allocate and fill the cache leaves of @cpu without touching the shared
+ * maps. This does not have to run on @cpu, so architectures can call it
+ * for CPUs that are not online yet to keep it out of the bring-up path.
+ */
+int fetch_cache_info(unsigned int cpu)
 {
 	int ret;
 
-	/* Since early detection of the cacheinfo is allowed via this
-	 * function and this also gets called as CPU hotplug callbacks via
-	 * cacheinfo_cpu_online, the initialisation can be skipped and only
-	 * CPU maps can be updated as the CPU online status would be update
-	 * if called via cacheinfo_cpu_online path.
-	 */
 	if (per_cpu_cacheinfo(cpu))
-		goto update_cpu_map;
+		return 0;
 
 	if (init_cache_level(cpu) || !cache_leaves(cpu))
 		return -ENOENT;
@@ -394,9 +393,25 @@ int detect_cache_attributes(unsigned int cpu)
 	 */
 	ret = populate_cache_leaves(cpu);
 	if (ret)
-		goto free_ci;
+		free_cache_attributes(cpu);
+
+	return ret;
+}
+
+int detect_cache_attributes(unsigned int cpu)
+{
+	int ret;
+
+	/* Since early detection of the cacheinfo is allowed via this
+	 * function and this also gets called as CPU hotplug callbacks via
+	 * cacheinfo_cpu_online, the initialisation can be skipped and only
+	 * CPU maps can be updated as the CPU online status would be update
+	 * if called via cacheinfo_cpu_online path.
+	 */
+	ret = fetch_cache_info(cpu);
+	if (ret)
+		return ret;
 
-update_cpu_map:
 	/*
 	 * For systems using DT for cache hierarchy, fw_token
 	 * and shared_cpu_map will be set up here only if they are
@@ -405,14 +420,11 @@ int detect_cache_attributes(unsigned int cpu)
 	ret = cache_shared_cpu_map_setup(cpu);
 	if (ret) {
 		pr_warn("Unable to detect cache hierarchy for CPU %d\n", cpu);
-		goto free_ci;
+		free_cache_attributes(cpu);
+		return ret;
 	}
 
 	return 0;
-
-free_ci:
-	free_cache_attributes(cpu);
-	return ret;
 }
 
 /* pointer to cpuX/cache device */
@@ -57,6 +57,7 @@ static void clint_clear_ipi(void)
 static struct riscv_ipi_ops clint_ipi_ops = {
 	.ipi_inject = clint_send_ipi,
 	.ipi_clear = clint_clear_ipi,
+	.use_for_rfence = true,
 };
 
 #ifdef CONFIG_64BIT
@@ -5,6 +5,7 @@
  */
 #define pr_fmt(fmt) "plic: " fmt
 #include <linux/cpu.h>
+#include <linux/debugfs.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/irq.h>
@@ -16,7 +17,9 @@
 #include <linux/of_address.h>
 #include <linux/of_irq.h>
 #include <linux/platform_device.h>
+#include <linux/seq_file.h>
 #include <linux/spinlock.h>
+#include <linux/topology.h>
 #include <asm/smp.h>
 
 /*
@@ -62,6 +65,16 @@
 
 #define PLIC_QUIRK_EDGE_INTERRUPT	0
 
+/*
+ * Maximum number of interrupts claimed per entry into the chained handler.
+ * The external interrupt stays pending at the hart while the PLIC has work,
+ * so bailing out only gives the timer and IPIs a chance to run in between.
+ * Zero means claim until the PLIC runs dry.
+ */
+static unsigned int claim_budget = 32;
+module_param(claim_budget, uint, 0644);
+MODULE_PARM_DESC(claim_budget, "Max interrupts claimed per handler entry (0 = unlimited)");
+
 struct plic_priv {
 	struct cpumask lmask;
 	struct irq_domain *irqdomain;
@@ -79,6 +92,14 @@ struct plic_handler {
 	raw_spinlock_t		enable_lock;
 	void __iomem		*enable_base;
 	struct plic_priv	*priv;
+	/* Number of started interrupts whose effective affinity is this hart */
+	atomic_t		nr_routed;
+	/* Statistics, only updated by the owning hart */
+	u64			nr_entries;
+	u64			nr_claims;
+	u64			nr_spurious;
+	u64			nr_budget_exhausted;
+	unsigned int		max_batch;
 };
 static int plic_parent_irq __ro_after_init;
 static bool plic_cpuhp_setup_done __ro_after_init;
@@ -126,6 +147,34 @@ static void plic_irq_disable(struct irq_data *d)
 	plic_irq_toggle(irq_data_get_effective_affinity_mask(d), d, 0);
 }
 
+/* Adjust the routed count of the hart @d is currently steered to */
+static void plic_account_routed(struct irq_data *d, int delta)
+{
+	unsigned int cpu = cpumask_first(irq_data_get_effective_affinity_mask(d));
+
+	if (cpu < nr_cpu_ids)
+		atomic_add(delta, &per_cpu(plic_handlers, cpu).nr_routed);
+}
+
+/*
+ * Only started interrupts count towards a hart's load, so that the
+ * balancing in plic_set_affinity() reflects what is in use now rather
+ * than everything ever mapped.
+ */
+static unsigned int plic_irq_startup(struct irq_data *d)
+{
+	plic_account_routed(d, 1);
+	plic_irq_enable(d);
+
+	return 0;
+}
+
+static void plic_irq_shutdown(struct irq_data *d)
+{
+	plic_irq_disable(d);
+	plic_account_routed(d, -1);
+}
+
 static void plic_irq_unmask(struct irq_data *d)
 {
 	struct plic_priv *priv = irq_data_get_irq_chip_data(d);
@@ -154,6 +203,44 @@ static void plic_irq_eoi(struct irq_data *d)
 }
 
 #ifdef CONFIG_SMP
+/* Pick the online hart of @mask with the fewest interrupts routed to it. */
+static unsigned int plic_least_loaded_cpu(const struct cpumask *mask)
+{
+	unsigned int cpu, best = nr_cpu_ids;
+	int load, best_load = INT_MAX;
+
+	for_each_cpu_and(cpu, mask, cpu_online_mask) {
+		load = atomic_read(&per_cpu(plic_handlers, cpu).nr_routed);
+		if (load < best_load) {
+			best = cpu;
+			best_load = load;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Spread the interrupts over the allowed harts: stay on the device's NUMA
+ * node (which is also the cluster on multi-cluster parts such as the SG2042)
+ * when it has a candidate, and balance the number of routed interrupts.
+ */
+static unsigned int plic_pick_cpu(struct irq_data *d, const struct cpumask *amask)
+{
+	int node = irq_data_get_node(d);
+	struct cpumask nmask;
+	unsigned int cpu;
+
+	if (node != NUMA_NO_NODE) {
+		cpumask_and(&nmask, amask, cpumask_of_node(node));
+		cpu = plic_least_loaded_cpu(&nmask);
+		if (cpu < nr_cpu_ids)
+			return cpu;
+	}
+
+	return plic_least_loaded_cpu(amask);
+}
+
 static int plic_set_affinity(struct irq_data *d,
 			     const struct cpumask *mask_val, bool force)
 {
@@ -166,14 +253,19 @@ static int plic_set_affinity(struct irq_data *d,
 	if (force)
 		cpu = cpumask_first(&amask);
 	else
-		cpu = cpumask_any_and(&amask, cpu_online_mask);
+		cpu = plic_pick_cpu(d, &amask);
 
 	if (cpu >= nr_cpu_ids)
 		return -EINVAL;
 
 	plic_irq_disable(d);
 
+	/* move the load of a started interrupt along with it */
+	if (irqd_is_started(d))
+		plic_account_routed(d, -1);
 	irq_data_update_effective_affinity(d, cpumask_of(cpu));
+	if (irqd_is_started(d))
+		plic_account_routed(d, 1);
 
 	if (!irqd_irq_disabled(d))
 		plic_irq_enable(d);
@@ -184,6 +276,8 @@ static int plic_set_affinity(struct irq_data *d,
 
 static struct irq_chip plic_edge_chip = {
 	.name		= "SiFive PLIC",
+	.irq_startup	= plic_irq_startup,
+	.irq_shutdown	= plic_irq_shutdown,
 	.irq_enable	= plic_irq_enable,
 	.irq_disable	= plic_irq_disable,
 	.irq_ack	= plic_irq_eoi,
@@ -198,6 +292,8 @@ static struct irq_chip plic_edge_chip = {
 
 static struct irq_chip plic_chip = {
 	.name		= "SiFive PLIC",
+	.irq_startup	= plic_irq_startup,
+	.irq_shutdown	= plic_irq_shutdown,
 	.irq_enable	= plic_irq_enable,
 	.irq_disable	= plic_irq_disable,
 	.irq_mask	= plic_irq_mask,
@@ -290,12 +386,17 @@ static const struct irq_domain_ops plic_irqdomain_ops = {
  * by reading the claim register, then you complete the interrupt by writing
  * that source ID back to the same claim register.  This automatically enables
  * and disables the interrupt, so there's nothing else to do.
+ *
+ * Several interrupts are drained per entry, up to claim_budget of them, so
+ * that a burst costs one trap instead of one per interrupt.
  */
 static void plic_handle_irq(struct irq_desc *desc)
 {
 	struct plic_handler *handler = this_cpu_ptr(&plic_handlers);
 	struct irq_chip *chip = irq_desc_get_chip(desc);
 	void __iomem *claim = handler->hart_base + CONTEXT_CLAIM;
+	unsigned int budget = READ_ONCE(claim_budget);
+	unsigned int nr = 0;
 	irq_hw_number_t hwirq;
 
 	WARN_ON_ONCE(!handler->present);
@@ -308,10 +409,57 @@ static void plic_handle_irq(struct irq_desc *desc)
 		if (unlikely(err))
 			pr_warn_ratelimited("can't find mapping for hwirq %lu\n",
 					hwirq);
+
+		if (++nr == budget) {
+			handler->nr_budget_exhausted++;
+			break;
+		}
 	}
 
 	chained_irq_exit(chip, desc);
+
+	handler->nr_entries++;
+	handler->nr_claims += nr;
+	if (!nr)
+		handler->nr_spurious++;
+	if (nr > handler->max_batch)
+		handler->max_batch = nr;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int plic_stats_show(struct seq_file *m, void *v)
+{
+	struct plic_handler *handler;
+	int cpu;
+
+	seq_printf(m, "%-6s %10s %12s %12s %10s %10s %9s\n", "cpu", "routed",
+		   "entries", "claims", "spurious", "exhausted", "max_batch");
+
+	for_each_possible_cpu(cpu) {
+		handler = per_cpu_ptr(&plic_handlers, cpu);
+		if (!handler->present)
+			continue;
+
+		seq_printf(m, "cpu%-3d %10d %12llu %12llu %10llu %10llu %9u\n",
+			   cpu, atomic_read(&handler->nr_routed),
+			   handler->nr_entries, handler->nr_claims,
+			   handler->nr_spurious, handler->nr_budget_exhausted,
+			   handler->max_batch);
+	}
+
+	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(plic_stats);
+
+static int __init plic_debugfs_init(void)
+{
+	if (plic_parent_irq)
+		debugfs_create_file("sifive_plic", 0444, NULL, NULL,
+				    &plic_stats_fops);
+	return 0;
+}
+late_initcall(plic_debugfs_init);
+#endif
 
 static void plic_set_threshold(struct plic_handler *handler, u32 threshold)
 {
@@ -19,6 +19,7 @@
 #include <linux/of.h>
 #include <linux/cpu_pm.h>
 #include <linux/sched/clock.h>
+#include <linux/sysctl.h>
 
 #include <asm/errata_list.h>
 #include <asm/sbi.h>
@@ -52,6 +53,12 @@ static bool riscv_pmu_use_irq;
 static unsigned int riscv_pmu_irq_num;
 static unsigned int riscv_pmu_irq;
 
+/*
+ * 1: user space may read the counters of its own mmapped events directly.
+ * 0: only the legacy CYCLE, TIME and INSTRET CSRs are accessible.
+ */
+static int sysctl_perf_user_access __read_mostly = 1;
+
 struct sbi_pmu_event_data {
 	union {
 		union {
@@ -282,6 +289,16 @@ static int pmu_sbi_ctr_get_idx(struct perf_event *event)
 	if (event->attr.exclude_user)
 		cflags |= SBI_PMU_CFG_FLAG_SET_UINH;
 
+	/*
+	 * A counter released while the PMU was disabled still carries its old
+	 * mapping in the firmware. Reset it now so that it can be matched.
+	 */
+	if (cpuc->batch_reset) {
+		sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_STOP, 0,
+			  cpuc->batch_reset, SBI_PMU_STOP_FLAG_RESET, 0, 0, 0);
+		cpuc->batch_reset = 0;
+	}
+
 	/* retrieve the available counter index */
 #if defined(CONFIG_32BIT)
 	ret = sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_CFG_MATCH, cbase,
@@ -426,6 +443,39 @@ static u64 pmu_sbi_ctr_read(struct perf_event *event)
 	return val;
 }
 
+static int pmu_sbi_csr_index(struct perf_event *event)
+{
+	return pmu_ctr_list[event->hw.idx].csr - CSR_CYCLE;
+}
+
+static void pmu_sbi_set_scounteren(void *arg)
+{
+	struct perf_event *event = arg;
+
+	if (event->hw.idx != -1)
+		csr_set(CSR_SCOUNTEREN, BIT(pmu_sbi_csr_index(event)));
+}
+
+static void pmu_sbi_reset_scounteren(void *arg)
+{
+	struct perf_event *event = arg;
+	int hidx;
+
+	if (event->hw.idx == -1)
+		return;
+
+	/* CYCLE, TIME and INSTRET stay readable for uABI compatibility */
+	hidx = pmu_sbi_csr_index(event);
+	if (hidx > 2)
+		csr_clear(CSR_SCOUNTEREN, BIT(hidx));
+}
+
+static bool pmu_sbi_user_read_cnt(struct perf_event *event)
+{
+	return (event->hw.flags & PERF_EVENT_FLAG_USER_ACCESS) &&
+	       (event->hw.flags & PERF_EVENT_FLAG_USER_READ_CNT);
+}
+
 static void pmu_sbi_ctr_start(struct perf_event *event, u64 ival)
 {
 	struct sbiret ret;
@@ -442,12 +492,34 @@ static void pmu_sbi_ctr_start(struct perf_event *event, u64 ival)
 	if (ret.error && (ret.error != SBI_ERR_ALREADY_STARTED))
 		pr_err("Starting counter idx %d failed with error %d\n",
 			hwc->idx, sbi_err_map_linux_errno(ret.error));
+
+	if (pmu_sbi_user_read_cnt(event))
+		pmu_sbi_set_scounteren(event);
 }
 
 static void pmu_sbi_ctr_stop(struct perf_event *event, unsigned long flag)
 {
 	struct sbiret ret;
 	struct hw_perf_event *hwc = &event->hw;
+	struct riscv_pmu *rvpmu = to_riscv_pmu(event->pmu);
+	struct cpu_hw_events *cpuc = this_cpu_ptr(rvpmu->hw_events);
+
+	if (pmu_sbi_user_read_cnt(event))
+		pmu_sbi_reset_scounteren(event);
+
+	/*
+	 * While the PMU is disabled the counter has already been stopped by
+	 * pmu_sbi_pmu_disable(), and a reset can wait for pmu_sbi_pmu_enable().
+	 */
+	if (cpuc->disabled && hwc->idx < BITS_PER_LONG &&
+	    !pmu_sbi_ctr_is_fw(hwc->idx)) {
+		if (flag == RISCV_PMU_STOP_FLAG_RESET) {
+			__set_bit(hwc->idx, &cpuc->batch_reset);
+			return;
+		}
+		if (__test_and_clear_bit(hwc->idx, &cpuc->batch_stopped))
+			return;
+	}
 
 	ret = sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_STOP, hwc->idx, 1, flag, 0, 0, 0);
 	if (ret.error && (ret.error != SBI_ERR_ALREADY_STOPPED) &&
@@ -456,6 +528,106 @@ static void pmu_sbi_ctr_stop(struct perf_event *event, unsigned long flag)
 			hwc->idx, sbi_err_map_linux_errno(ret.error));
 }
 
+static void pmu_sbi_pmu_disable(struct pmu *pmu)
+{
+	struct riscv_pmu *rvpmu = to_riscv_pmu(pmu);
+	struct cpu_hw_events *cpuc = this_cpu_ptr(rvpmu->hw_events);
+	struct perf_event *event;
+	unsigned long mask = 0;
+	int idx;
+
+	for_each_set_bit(idx, cpuc->used_hw_ctrs, BITS_PER_LONG) {
+		event = cpuc->events[idx];
+		if (event && !(event->hw.state & PERF_HES_STOPPED))
+			mask |= BIT(idx);
+	}
+
+	/* Stop all the running hardware counters with a single call */
+	if (mask)
+		sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_STOP, 0, mask,
+			  0, 0, 0, 0);
+
+	cpuc->batch_stopped = mask;
+	cpuc->disabled = true;
+}
+
+static void pmu_sbi_pmu_enable(struct pmu *pmu)
+{
+	struct riscv_pmu *rvpmu = to_riscv_pmu(pmu);
+	struct cpu_hw_events *cpuc = this_cpu_ptr(rvpmu->hw_events);
+
+	cpuc->disabled = false;
+
+	if (cpuc->batch_reset) {
+		sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_STOP, 0,
+			  cpuc->batch_reset, SBI_PMU_STOP_FLAG_RESET, 0, 0, 0);
+		cpuc->batch_reset = 0;
+	}
+
+	/*
+	 * Counters that were neither stopped nor removed in the meantime resume
+	 * from where they were stopped, without reprogramming their value.
+	 */
+	if (cpuc->batch_stopped) {
+		sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_START, 0,
+			  cpuc->batch_stopped, 0, 0, 0, 0);
+		cpuc->batch_stopped = 0;
+	}
+}
+
+static void pmu_sbi_event_init(struct perf_event *event)
+{
+	/* Firmware counters are only readable through an SBI call */
+	if (sysctl_perf_user_access && !pmu_sbi_is_fw_event(event))
+		event->hw.flags |= PERF_EVENT_FLAG_USER_ACCESS;
+}
+
+static void pmu_sbi_event_mapped(struct perf_event *event, struct mm_struct *mm)
+{
+	if (!(event->hw.flags & PERF_EVENT_FLAG_USER_ACCESS))
+		return;
+
+	event->hw.flags |= PERF_EVENT_FLAG_USER_READ_CNT;
+
+	/*
+	 * The event may already be running on a CPU this mm is active on:
+	 * open up its counter there right away.
+	 */
+	on_each_cpu_mask(mm_cpumask(mm), pmu_sbi_set_scounteren, event, 1);
+}
+
+static void pmu_sbi_event_unmapped(struct perf_event *event, struct mm_struct *mm)
+{
+	if (!(event->hw.flags & PERF_EVENT_FLAG_USER_ACCESS))
+		return;
+
+	on_each_cpu_mask(mm_cpumask(mm), pmu_sbi_reset_scounteren, event, 1);
+
+	event->hw.flags &= ~PERF_EVENT_FLAG_USER_READ_CNT;
+}
+
+static int pmu_sbi_event_idx(struct perf_event *event)
+{
+	if (event->hw.idx == -1 || pmu_sbi_is_fw_event(event))
+		return 0;
+
+	/* perf_event_mmap_page::index is the counter CSR index plus one */
+	return pmu_sbi_csr_index(event) + 1;
+}
+
+static struct ctl_table sbi_pmu_sysctl_table[] = {
+	{
+		.procname	= "perf_user_access",
+		.data		= &sysctl_perf_user_access,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE,
+	},
+	{ }
+};
+
 static int pmu_sbi_find_num_ctrs(void)
 {
 	struct sbiret ret;
@@ -847,6 +1019,12 @@ static int pmu_sbi_device_probe(struct platform_device *pdev)
 	pmu->ctr_get_width = pmu_sbi_ctr_get_width;
 	pmu->ctr_clear_idx = pmu_sbi_ctr_clear_idx;
 	pmu->ctr_read = pmu_sbi_ctr_read;
+	pmu->event_init = pmu_sbi_event_init;
+	pmu->event_mapped = pmu_sbi_event_mapped;
+	pmu->event_unmapped = pmu_sbi_event_unmapped;
+	pmu->event_idx = pmu_sbi_event_idx;
+	pmu->pmu.pmu_enable = pmu_sbi_pmu_enable;
+	pmu->pmu.pmu_disable = pmu_sbi_pmu_disable;
 
 	ret = cpuhp_state_add_instance(CPUHP_AP_PERF_RISCV_STARTING, &pmu->node);
 	if (ret)
@@ -860,6 +1038,8 @@ static int pmu_sbi_device_probe(struct platform_device *pdev)
 	if (ret)
 		goto out_unregister;
 
+	register_sysctl("kernel", sbi_pmu_sysctl_table);
+
 	return 0;
 
 out_unregister:
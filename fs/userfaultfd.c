@@ -113,6 +113,7 @@ static void userfaultfd_set_vm_flags(struct vm_area_struct *vma,
 {
 	const bool uffd_wp_changed = (vma->vm_flags ^ flags) & VM_UFFD_WP;
 
+	vma_start_write(vma);
 	vma->vm_flags = flags;
 	/*
 	 * For shared mappings, we want to enable writenotify while
@@ -171,6 +171,53 @@ static inline bool file_thp_enabled(struct vm_area_struct *vma)
 bool hugepage_vma_check(struct vm_area_struct *vma, unsigned long vm_flags,
 			bool smaps, bool in_pf, bool enforce_sysfs);
 
+/*
+ * Orders of PTE-mapped anonymous folios the fault path may allocate. Order-1
+ * is excluded because the deferred split list lives in the third page of a
+ * large folio; PMD order is handled by do_huge_pmd_anonymous_page().
+ */
+#define THP_ORDERS_ALL_ANON_PTE						\
+	((BIT(HPAGE_PMD_ORDER) - 1) & ~(BIT(0) | BIT(1)))
+
+extern unsigned long huge_anon_orders_always;
+extern unsigned long huge_anon_orders_madvise;
+extern unsigned long huge_anon_orders_inherit;
+
+unsigned long anon_vma_allowable_orders(struct vm_area_struct *vma,
+					unsigned long vm_flags);
+
+static inline int highest_order(unsigned long orders)
+{
+	return fls_long(orders) - 1;
+}
+
+static inline int next_order(unsigned long *orders, int prev)
+{
+	*orders &= ~BIT(prev);
+	return highest_order(*orders);
+}
+
+enum mthp_stat_item {
+	MTHP_STAT_ANON_FAULT_ALLOC,
+	MTHP_STAT_ANON_FAULT_FALLBACK,
+	MTHP_STAT_ANON_FAULT_FALLBACK_CHARGE,
+	__MTHP_STAT_COUNT
+};
+
+struct mthp_stat {
+	unsigned long stats[ilog2(MAX_PTRS_PER_PTE) + 1][__MTHP_STAT_COUNT];
+};
+
+DECLARE_PER_CPU(struct mthp_stat, mthp_stats);
+
+static inline void count_mthp_stat(int order, enum mthp_stat_item item)
+{
+	if (order <= 0 || order > ilog2(MAX_PTRS_PER_PTE))
+		return;
+
+	this_cpu_inc(mthp_stats.stats[order][item]);
+}
+
 #define transparent_hugepage_use_zero_page()				\
 	(transparent_hugepage_flags &					\
 	 (1<<TRANSPARENT_HUGEPAGE_USE_ZERO_PAGE_FLAG))
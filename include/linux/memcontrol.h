@@ -191,6 +191,10 @@ struct obj_cgroup {
 	struct percpu_ref refcnt;
 	struct mem_cgroup *memcg;
 	atomic_t nr_charged_bytes;
+#ifdef CONFIG_ZSWAP
+	/* consecutive poorly compressing zswap stores, see zswap.c */
+	atomic_t zswap_poor_streak;
+#endif
 	union {
 		struct list_head list; /* protected by objcg_lock */
 		struct rcu_head rcu;
@@ -450,6 +450,21 @@ struct vm_area_struct {
 
 	struct mm_struct *vm_mm;	/* The address space we belong to. */
 
+#ifdef CONFIG_PER_VMA_LOCK
+	/*
+	 * The VMA is write-locked while vm_lock_seq matches the mm's
+	 * mm_lock_seq. Both are only written under mmap_lock held for
+	 * write, and mmap_write_unlock() releases all such VMA locks at
+	 * once by bumping mm_lock_seq.
+	 */
+	int vm_lock_seq;
+	struct rw_semaphore lock;
+	/* Set once the VMA has been removed from the tree */
+	bool detached;
+	/* The VMA is freed after an RCU grace period */
+	struct rcu_head vm_rcu;
+#endif
+
 	/*
 	 * Access permissions of this VMA.
 	 * See vmf_insert_mixed_prot() for discussion.
@@ -578,6 +593,10 @@ struct mm_struct {
 		 * cacheline.
 		 */
 		struct rw_semaphore mmap_lock;
+#ifdef CONFIG_PER_VMA_LOCK
+		/* Bumped on every mmap_write_unlock(), see vm_lock_seq */
+		int mm_lock_seq;
+#endif
 
 		struct list_head mmlist; /* List of maybe swapped mm's.	These
 					  * are globally strung together off
@@ -963,6 +982,8 @@ typedef struct {
  *                      mapped R/O.
  * @FAULT_FLAG_ORIG_PTE_VALID: whether the fault has vmf->orig_pte cached.
  *                        We should only access orig_pte if this flag set.
+ * @FAULT_FLAG_VMA_LOCK: The fault is handled under VMA lock instead of
+ *                       mmap_lock.
  *
  * About @FAULT_FLAG_ALLOW_RETRY and @FAULT_FLAG_TRIED: we can specify
  * whether we would allow page faults to retry by specifying these two
@@ -1000,6 +1021,7 @@ enum fault_flag {
 	FAULT_FLAG_INTERRUPTIBLE =	1 << 9,
 	FAULT_FLAG_UNSHARE =		1 << 10,
 	FAULT_FLAG_ORIG_PTE_VALID =	1 << 11,
+	FAULT_FLAG_VMA_LOCK =		1 << 12,
 };
 
 typedef unsigned int __bitwise zap_flags_t;
@@ -26,6 +26,9 @@
 
 #define RISCV_PMU_STOP_FLAG_RESET 1
 
+/* Direct userspace access to the counter of an mmapped event is allowed */
+#define PERF_EVENT_FLAG_USER_ACCESS	BIT(0)
+
 struct cpu_hw_events {
 	/* currently enabled events */
 	int			n_events;
@@ -37,6 +40,12 @@ struct cpu_hw_events {
 	DECLARE_BITMAP(used_hw_ctrs, RISCV_MAX_COUNTERS);
 	/* currently enabled firmware counters */
 	DECLARE_BITMAP(used_fw_ctrs, RISCV_MAX_COUNTERS);
+	/* pmu_disable() is in effect */
+	bool			disabled;
+	/* counters stopped by pmu_disable() to be restarted by pmu_enable() */
+	unsigned long		batch_stopped;
+	/* counters whose reset was deferred to pmu_enable() */
+	unsigned long		batch_reset;
 };
 
 struct riscv_pmu {
@@ -53,6 +62,10 @@ struct riscv_pmu {
 	void		(*ctr_start)(struct perf_event *event, u64 init_val);
 	void		(*ctr_stop)(struct perf_event *event, unsigned long flag);
 	int		(*event_map)(struct perf_event *event, u64 *config);
+	void		(*event_init)(struct perf_event *event);
+	void		(*event_mapped)(struct perf_event *event, struct mm_struct *mm);
+	void		(*event_unmapped)(struct perf_event *event, struct mm_struct *mm);
+	int		(*event_idx)(struct perf_event *event);
 
 	struct cpu_hw_events	__percpu *hw_events;
 	struct hlist_node	node;
@@ -172,6 +172,43 @@ static inline int pmd_young(pmd_t pmd)
 }
 #endif
 
+#ifndef pte_next_pfn
+/* Return @pte advanced to the next page frame, other bits unchanged. */
+static inline pte_t pte_next_pfn(pte_t pte)
+{
+	return __pte(pte_val(pte) + pte_val(pfn_pte(1, __pgprot(0))));
+}
+#endif
+
+#ifndef set_ptes
+/**
+ * set_ptes - Map consecutive pages to a contiguous range of addresses.
+ * @mm: Address space to map the pages into.
+ * @addr: Address to map the first page at.
+ * @ptep: Page table pointer for the first entry.
+ * @pte: Page table entry for the first page.
+ * @nr: Number of pages to map.
+ *
+ * The pages must all belong to the same folio and sit in the same page
+ * table. Architectures can override this to batch the cache and TLB
+ * maintenance of the whole range.
+ *
+ * Context: The caller holds the page table lock.
+ */
+static inline void set_ptes(struct mm_struct *mm, unsigned long addr,
+			    pte_t *ptep, pte_t pte, unsigned int nr)
+{
+	for (;;) {
+		set_pte_at(mm, addr, ptep, pte);
+		if (--nr == 0)
+			break;
+		ptep++;
+		addr += PAGE_SIZE;
+		pte = pte_next_pfn(pte);
+	}
+}
+#endif
+
 #ifndef __HAVE_ARCH_PTEP_SET_ACCESS_FLAGS
 extern int ptep_set_access_flags(struct vm_area_struct *vma,
 				 unsigned long address, pte_t *ptep,
@@ -137,6 +137,9 @@ extern const struct raid6_calls raid6_neonx2;
 extern const struct raid6_calls raid6_neonx4;
 extern const struct raid6_calls raid6_neonx8;
 
+extern const struct raid6_recov_calls raid6_recov_rvv;
+extern const struct raid6_calls raid6_rvvx1;
+
 /* Algorithm list */
 extern const struct raid6_calls * const raid6_algos[];
 extern const struct raid6_recov_calls *const raid6_recov_algos[];
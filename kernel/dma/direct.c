@@ -419,10 +419,15 @@ void dma_direct_sync_sg_for_device(struct device *dev,
 			swiotlb_sync_single_for_device(dev, paddr, sg->length,
 						       dir);
 
-		if (!dev_is_dma_coherent(dev))
+		if (!IS_ENABLED(CONFIG_ARCH_HAS_SYNC_DMA_SG) &&
+		    !dev_is_dma_coherent(dev))
 			arch_sync_dma_for_device(paddr, sg->length,
 					dir);
 	}
+
+	if (IS_ENABLED(CONFIG_ARCH_HAS_SYNC_DMA_SG) &&
+	    !dev_is_dma_coherent(dev))
+		arch_sync_dma_sg_for_device(dev, sgl, nents, dir);
 }
 #endif
 
@@ -435,10 +440,15 @@ void dma_direct_sync_sg_for_cpu(struct device *dev,
 	struct scatterlist *sg;
 	int i;
 
+	if (IS_ENABLED(CONFIG_ARCH_HAS_SYNC_DMA_SG) &&
+	    !dev_is_dma_coherent(dev))
+		arch_sync_dma_sg_for_cpu(dev, sgl, nents, dir);
+
 	for_each_sg(sgl, sg, nents, i) {
 		phys_addr_t paddr = dma_to_phys(dev, sg_dma_address(sg));
 
-		if (!dev_is_dma_coherent(dev))
+		if (!IS_ENABLED(CONFIG_ARCH_HAS_SYNC_DMA_SG) &&
+		    !dev_is_dma_coherent(dev))
 			arch_sync_dma_for_cpu(paddr, sg->length, dir);
 
 		if (unlikely(is_swiotlb_buffer(dev, paddr)))
@@ -463,6 +473,16 @@ void dma_direct_unmap_sg(struct device *dev, struct scatterlist *sgl,
 	struct scatterlist *sg;
 	int i;
 
+	/*
+	 * Let the architecture do the cache maintenance for the whole list
+	 * in one go rather than once per segment from dma_direct_unmap_page.
+	 */
+	if (IS_ENABLED(CONFIG_ARCH_HAS_SYNC_DMA_SG) &&
+	    !dev_is_dma_coherent(dev) && !(attrs & DMA_ATTR_SKIP_CPU_SYNC)) {
+		dma_direct_sync_sg_for_cpu(dev, sgl, nents, dir);
+		attrs |= DMA_ATTR_SKIP_CPU_SYNC;
+	}
+
 	for_each_sg(sgl,  sg, nents, i) {
 		if (sg_is_dma_bus_address(sg))
 			sg_dma_unmark_bus_address(sg);
@@ -478,9 +498,17 @@ int dma_direct_map_sg(struct device *dev, struct scatterlist *sgl, int nents,
 {
 	struct pci_p2pdma_map_state p2pdma_state = {};
 	enum pci_p2pdma_map_type map;
+	unsigned long map_attrs = attrs;
+	bool sync_sg = false;
 	struct scatterlist *sg;
 	int i, ret;
 
+	if (IS_ENABLED(CONFIG_ARCH_HAS_SYNC_DMA_SG) &&
+	    !dev_is_dma_coherent(dev) && !(attrs & DMA_ATTR_SKIP_CPU_SYNC)) {
+		map_attrs |= DMA_ATTR_SKIP_CPU_SYNC;
+		sync_sg = true;
+	}
+
 	for_each_sg(sgl, sg, nents, i) {
 		if (is_pci_p2pdma_page(sg_page(sg))) {
 			map = pci_p2pdma_map_segment(&p2pdma_state, dev, sg);
@@ -502,7 +530,7 @@ int dma_direct_map_sg(struct device *dev, struct scatterlist *sgl, int nents,
 		}
 
 		sg->dma_address = dma_direct_map_page(dev, sg_page(sg),
-				sg->offset, sg->length, dir, attrs);
+				sg->offset, sg->length, dir, map_attrs);
 		if (sg->dma_address == DMA_MAPPING_ERROR) {
 			ret = -EIO;
 			goto out_unmap;
@@ -510,6 +538,9 @@ int dma_direct_map_sg(struct device *dev, struct scatterlist *sgl, int nents,
 		sg_dma_len(sg) = sg->length;
 	}
 
+	if (sync_sg)
+		arch_sync_dma_sg_for_device(dev, sgl, nents, dir);
+
 	return nents;
 
 out_unmap:
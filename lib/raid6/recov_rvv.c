@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * RAID6 recovery using the RISC-V vector 0.7.1 extension
+ *
+ * Based on recov_neon.c; the 4-bit table lookups are done with
+ * vrgather.vv on one 16 byte e8/m1 register at a time.
+ */
+
+#include <linux/raid/pq.h>
+#include <asm/insn-def.h>
+#include <asm/vector.h>
+
+/*
+ * The nibble tables are loaded whole into one register, so the harts need
+ * VLEN >= 128 for vsetvli to grant the 16 bytes asked for.
+ */
+static int raid6_has_rvv(void)
+{
+	unsigned long vlenb;
+
+	if (!has_vector())
+		return 0;
+
+	kernel_vector_begin();
+	vlenb = csr_read(CSR_VLENB);
+	kernel_vector_end();
+
+	return vlenb >= 16;
+}
+
+static void __raid6_2data_recov_rvv(int bytes, u8 *p, u8 *q, u8 *dp,
+				    u8 *dq, const u8 *pbmul,
+				    const u8 *qmul)
+{
+	unsigned long vl;
+
+	/*
+	 * while ( bytes-- ) {
+	 *	uint8_t px, qx, db;
+	 *
+	 *	px    = *p ^ *dp;
+	 *	qx    = qmul[*q ^ *dq];
+	 *	*dq++ = db = pbmul[px] ^ qx;
+	 *	*dp++ = db ^ px;
+	 *	p++; q++;
+	 * }
+	 */
+	asm volatile(VSETVLI_E8M1(%0, %1) : "=r" (vl) : "r" (16));
+
+	/* v0/v1: pbmul low/high nibble tables, v2/v3: same for qmul */
+	asm volatile(VLB_V(0, %0)
+		     VLB_V(1, %1)
+		     VLB_V(2, %2)
+		     VLB_V(3, %3)
+		     : : "r" (pbmul), "r" (pbmul + 16),
+			 "r" (qmul), "r" (qmul + 16));
+
+	while (bytes) {
+		asm volatile(/* v4 = px = *p ^ *dp */
+			     VLB_V(4, %[p])
+			     VLB_V(5, %[dp])
+			     VXOR_VV(4, 4, 5)
+			     /* v9 = qx = qmul[*q ^ *dq] */
+			     VLB_V(6, %[q])
+			     VLB_V(7, %[dq])
+			     VXOR_VV(6, 6, 7)
+			     VSRL_VI(8, 6, 4)
+			     VAND_VI(6, 6, 15)
+			     VRGATHER_VV(9, 2, 6)
+			     VRGATHER_VV(10, 3, 8)
+			     VXOR_VV(9, 9, 10)
+			     /* v10 = db = pbmul[px] ^ qx */
+			     VSRL_VI(8, 4, 4)
+			     VAND_VI(6, 4, 15)
+			     VRGATHER_VV(10, 0, 6)
+			     VRGATHER_VV(11, 1, 8)
+			     VXOR_VV(10, 10, 11)
+			     VXOR_VV(10, 10, 9)
+			     /* *dq = db; *dp = db ^ px */
+			     VSB_V(10, %[dq])
+			     VXOR_VV(10, 10, 4)
+			     VSB_V(10, %[dp])
+			     : : [p] "r" (p), [q] "r" (q),
+				 [dp] "r" (dp), [dq] "r" (dq)
+			     : "memory");
+
+		bytes -= vl;
+		p += vl;
+		q += vl;
+		dp += vl;
+		dq += vl;
+	}
+}
+
+static void __raid6_datap_recov_rvv(int bytes, u8 *p, u8 *q, u8 *dq,
+				    const u8 *qmul)
+{
+	unsigned long vl;
+
+	/*
+	 * while (bytes--) {
+	 *	*p++ ^= *dq = qmul[*q ^ *dq];
+	 *	q++; dq++;
+	 * }
+	 */
+	asm volatile(VSETVLI_E8M1(%0, %1) : "=r" (vl) : "r" (16));
+
+	/* v2/v3: qmul low/high nibble tables */
+	asm volatile(VLB_V(2, %0)
+		     VLB_V(3, %1)
+		     : : "r" (qmul), "r" (qmul + 16));
+
+	while (bytes) {
+		asm volatile(/* v9 = qmul[*q ^ *dq] */
+			     VLB_V(6, %[q])
+			     VLB_V(7, %[dq])
+			     VXOR_VV(6, 6, 7)
+			     VSRL_VI(8, 6, 4)
+			     VAND_VI(6, 6, 15)
+			     VRGATHER_VV(9, 2, 6)
+			     VRGATHER_VV(10, 3, 8)
+			     VXOR_VV(9, 9, 10)
+			     /* *dq = v9; *p ^= v9 */
+			     VSB_V(9, %[dq])
+			     VLB_V(11, %[p])
+			     VXOR_VV(11, 11, 9)
+			     VSB_V(11, %[p])
+			     : : [p] "r" (p), [q] "r" (q), [dq] "r" (dq)
+			     : "memory");
+
+		bytes -= vl;
+		p += vl;
+		q += vl;
+		dq += vl;
+	}
+}
+
+static void raid6_2data_recov_rvv(int disks, size_t bytes, int faila,
+		int failb, void **ptrs)
+{
+	u8 *p, *q, *dp, *dq;
+	const u8 *pbmul;	/* P multiplier table for B data */
+	const u8 *qmul;		/* Q multiplier table (for both) */
+
+	p = (u8 *)ptrs[disks - 2];
+	q = (u8 *)ptrs[disks - 1];
+
+	/*
+	 * Compute syndrome with zero for the missing data pages
+	 * Use the dead data pages as temporary storage for
+	 * delta p and delta q
+	 */
+	dp = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks - 2] = dp;
+	dq = (u8 *)ptrs[failb];
+	ptrs[failb] = (void *)raid6_empty_zero_page;
+	ptrs[disks - 1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]     = dp;
+	ptrs[failb]     = dq;
+	ptrs[disks - 2] = p;
+	ptrs[disks - 1] = q;
+
+	/* Now, pick the proper data tables */
+	pbmul = raid6_vgfmul[raid6_gfexi[failb-faila]];
+	qmul  = raid6_vgfmul[raid6_gfinv[raid6_gfexp[faila] ^
+					 raid6_gfexp[failb]]];
+
+	kernel_vector_begin();
+	__raid6_2data_recov_rvv(bytes, p, q, dp, dq, pbmul, qmul);
+	kernel_vector_end();
+}
+
+static void raid6_datap_recov_rvv(int disks, size_t bytes, int faila,
+		void **ptrs)
+{
+	u8 *p, *q, *dq;
+	const u8 *qmul;		/* Q multiplier table */
+
+	p = (u8 *)ptrs[disks - 2];
+	q = (u8 *)ptrs[disks - 1];
+
+	/*
+	 * Compute syndrome with zero for the missing data page
+	 * Use the dead data page as temporary storage for delta q
+	 */
+	dq = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks - 1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]     = dq;
+	ptrs[disks - 1] = q;
+
+	/* Now, pick the proper data tables */
+	qmul = raid6_vgfmul[raid6_gfinv[raid6_gfexp[faila]]];
+
+	kernel_vector_begin();
+	__raid6_datap_recov_rvv(bytes, p, q, dq, qmul);
+	kernel_vector_end();
+}
+
+const struct raid6_recov_calls raid6_recov_rvv = {
+	.data2		= raid6_2data_recov_rvv,
+	.datap		= raid6_datap_recov_rvv,
+	.valid		= raid6_has_rvv,
+	.name		= "rvv",
+	.priority	= 1,
+};
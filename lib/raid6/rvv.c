@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * RAID6 syndrome calculation using the RISC-V vector 0.7.1 extension
+ *
+ * Follows the algorithm of int.uc, processing one e8/m4 register group
+ * (64 bytes on a 128-bit VLEN core) per step:
+ *
+ *	v0-v3:   wp
+ *	v4-v7:   wq
+ *	v8-v11:  wd
+ *	v12-v15: w1
+ *	v16-v19: w2
+ */
+
+#include <linux/raid/pq.h>
+#include <asm/insn-def.h>
+#include <asm/vector.h>
+
+static int raid6_has_rvv(void)
+{
+	return has_vector();
+}
+
+/* wq = (wq << 1) ^ (MASK(wq) & 0x1d) */
+#define RVV_MUL2_WQ						\
+	VSRA_VI(16, 4, 7)					\
+	VAND_VX(16, 16, %[poly])				\
+	VADD_VV(12, 4, 4)					\
+	VXOR_VV(4, 12, 16)
+
+static void raid6_rvv_gen_syndrome_real(int disks, unsigned long bytes,
+					void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	unsigned long d, vl;
+	u8 *p, *q;
+	int z, z0;
+
+	z0 = disks - 3;		/* Highest data disk */
+	p = dptr[z0 + 1];	/* XOR parity */
+	q = dptr[z0 + 2];	/* RS syndrome */
+
+	for (d = 0; d < bytes; d += vl) {
+		asm volatile(VSETVLI_E8M4(%0, %1)
+			     : "=r" (vl) : "r" (bytes - d));
+
+		/* wq = wp = *(dptr[z0] + d) */
+		asm volatile(VLB_V(0, %0)
+			     VMV_V_V(4, 0)
+			     : : "r" (&dptr[z0][d]));
+
+		for (z = z0 - 1; z >= 0; z--) {
+			/* wd = *(dptr[z] + d); wp ^= wd; wq = 2 * wq ^ wd */
+			asm volatile(VLB_V(8, %[wd])
+				     VXOR_VV(0, 0, 8)
+				     RVV_MUL2_WQ
+				     VXOR_VV(4, 4, 8)
+				     : : [wd] "r" (&dptr[z][d]),
+					 [poly] "r" (0x1d));
+		}
+
+		/* *(p + d) = wp; *(q + d) = wq */
+		asm volatile(VSB_V(0, %0)
+			     VSB_V(4, %1)
+			     : : "r" (&p[d]), "r" (&q[d]) : "memory");
+	}
+}
+
+static void raid6_rvv_xor_syndrome_real(int disks, int start, int stop,
+					unsigned long bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	unsigned long d, vl;
+	u8 *p, *q;
+	int z, z0;
+
+	z0 = stop;		/* P/Q right side optimization */
+	p = dptr[disks - 2];	/* XOR parity */
+	q = dptr[disks - 1];	/* RS syndrome */
+
+	for (d = 0; d < bytes; d += vl) {
+		asm volatile(VSETVLI_E8M4(%0, %1)
+			     : "=r" (vl) : "r" (bytes - d));
+
+		/* wq = wp = *(dptr[z0] + d) */
+		asm volatile(VLB_V(0, %0)
+			     VMV_V_V(4, 0)
+			     : : "r" (&dptr[z0][d]));
+
+		/* P/Q data pages */
+		for (z = z0 - 1; z >= start; z--) {
+			asm volatile(VLB_V(8, %[wd])
+				     VXOR_VV(0, 0, 8)
+				     RVV_MUL2_WQ
+				     VXOR_VV(4, 4, 8)
+				     : : [wd] "r" (&dptr[z][d]),
+					 [poly] "r" (0x1d));
+		}
+
+		/* P/Q left side optimization */
+		for (z = start - 1; z >= 0; z--) {
+			asm volatile(RVV_MUL2_WQ
+				     : : [poly] "r" (0x1d));
+		}
+
+		/* *(p + d) ^= wp; *(q + d) ^= wq */
+		asm volatile(VLB_V(8, %0)
+			     VXOR_VV(0, 0, 8)
+			     VSB_V(0, %0)
+			     VLB_V(8, %1)
+			     VXOR_VV(4, 4, 8)
+			     VSB_V(4, %1)
+			     : : "r" (&p[d]), "r" (&q[d]) : "memory");
+	}
+}
+
+static void raid6_rvv_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+	kernel_vector_begin();
+	raid6_rvv_gen_syndrome_real(disks, (unsigned long)bytes, ptrs);
+	kernel_vector_end();
+}
+
+static void raid6_rvv_xor_syndrome(int disks, int start, int stop,
+				   size_t bytes, void **ptrs)
+{
+	kernel_vector_begin();
+	raid6_rvv_xor_syndrome_real(disks, start, stop,
+				    (unsigned long)bytes, ptrs);
+	kernel_vector_end();
+}
+
+const struct raid6_calls raid6_rvvx1 = {
+	raid6_rvv_gen_syndrome,
+	raid6_rvv_xor_syndrome,
+	raid6_has_rvv,
+	"rvvx1",
+	0
+};
@@ -159,6 +159,8 @@ static inline void __frontswap_clear(struct swap_info_struct *sis,
  * If frontswap already contains a page with matching swaptype and
  * offset, the frontswap implementation may either overwrite the data and
  * return success or invalidate the page from frontswap and return failure.
+ * A large folio is handed to the implementation in one call and covers
+ * as many consecutive offsets as it has pages.
  */
 int __frontswap_store(struct page *page)
 {
@@ -167,6 +169,7 @@ int __frontswap_store(struct page *page)
 	int type = swp_type(entry);
 	struct swap_info_struct *sis = swap_info[type];
 	pgoff_t offset = swp_offset(entry);
+	long i, nr_pages = compound_nr(page);
 
 	VM_BUG_ON(!frontswap_ops);
 	VM_BUG_ON(!PageLocked(page));
@@ -178,14 +181,17 @@ int __frontswap_store(struct page *page)
 	 * and we can't rely on the new page replacing the old page as we may
 	 * not store to the same implementation that contains the old page.
 	 */
-	if (__frontswap_test(sis, offset)) {
-		__frontswap_clear(sis, offset);
-		frontswap_ops->invalidate_page(type, offset);
+	for (i = 0; i < nr_pages; i++) {
+		if (__frontswap_test(sis, offset + i)) {
+			__frontswap_clear(sis, offset + i);
+			frontswap_ops->invalidate_page(type, offset + i);
+		}
 	}
 
 	ret = frontswap_ops->store(type, offset, page);
 	if (ret == 0) {
-		__frontswap_set(sis, offset);
+		for (i = 0; i < nr_pages; i++)
+			__frontswap_set(sis, offset + i);
 		inc_frontswap_succ_stores();
 	} else {
 		inc_frontswap_failed_stores();
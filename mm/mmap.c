@@ -475,6 +475,8 @@ static int vma_link(struct mm_struct *mm, struct vm_area_struct *vma)
 	if (mas_preallocate(&mas, vma, GFP_KERNEL))
 		return -ENOMEM;
 
+	vma_start_write(vma);
+
 	if (vma->vm_file) {
 		mapping = vma->vm_file->f_mapping;
 		i_mmap_lock_write(mapping);
@@ -541,6 +543,10 @@ inline int vma_expand(struct ma_state *mas, struct vm_area_struct *vma,
 	/* Only handles expanding */
 	VM_BUG_ON(vma->vm_start < start || vma->vm_end > end);
 
+	vma_start_write(vma);
+	if (remove_next)
+		vma_start_write(next);
+
 	if (mas_preallocate(mas, vma, GFP_KERNEL))
 		goto nomem;
 
@@ -721,6 +727,14 @@ int __vma_adjust(struct vm_area_struct *vma, unsigned long start,
 		}
 	}
 
+	vma_start_write(vma);
+	if (remove_next || adjust_next)
+		vma_start_write(next);
+	if (remove_next == 2)
+		vma_start_write(next_next);
+	if (insert)
+		vma_start_write(insert);
+
 	if (mas_preallocate(&mas, vma, GFP_KERNEL)) {
 		if (anon_dup)
 			unlink_anon_vmas(anon_dup);
@@ -1999,6 +2013,9 @@ static int expand_upwards(struct vm_area_struct *vma, unsigned long address)
 		return -ENOMEM;
 	}
 
+	/* Lock the VMA before expanding to prevent concurrent page faults */
+	vma_start_write(vma);
+
 	/*
 	 * vma->vm_start/vm_end cannot change under us because the caller
 	 * is required to hold the mmap_lock in read mode.  We need the
@@ -2085,6 +2102,9 @@ int expand_downwards(struct vm_area_struct *vma, unsigned long address)
 		return -ENOMEM;
 	}
 
+	/* Lock the VMA before expanding to prevent concurrent page faults */
+	vma_start_write(vma);
+
 	/*
 	 * vma->vm_start/vm_end cannot change under us because the caller
 	 * is required to hold the mmap_lock in read mode.  We need the
@@ -2431,7 +2451,7 @@ do_mas_align_munmap(struct ma_state *mas, struct vm_area_struct *vma,
 		    struct mm_struct *mm, unsigned long start,
 		    unsigned long end, struct list_head *uf, bool downgrade)
 {
-	struct vm_area_struct *prev, *next = NULL;
+	struct vm_area_struct *prev, *next = NULL, *tmp;
 	struct maple_tree mt_detach;
 	int count = 0;
 	int error = -ENOMEM;
@@ -2494,6 +2514,7 @@ do_mas_align_munmap(struct ma_state *mas, struct vm_area_struct *vma,
 
 			mas_set(mas, end);
 			split = mas_prev(mas, 0);
+			vma_start_write(split);
 			mas_set_range(&mas_detach, split->vm_start, split->vm_end - 1);
 			error = mas_store_gfp(&mas_detach, split, GFP_KERNEL);
 			if (error)
@@ -2506,6 +2527,7 @@ do_mas_align_munmap(struct ma_state *mas, struct vm_area_struct *vma,
 				vma = split;
 			break;
 		}
+		vma_start_write(next);
 		mas_set_range(&mas_detach, next->vm_start, next->vm_end - 1);
 		error = mas_store_gfp(&mas_detach, next, GFP_KERNEL);
 		if (error)
@@ -2560,6 +2582,14 @@ do_mas_align_munmap(struct ma_state *mas, struct vm_area_struct *vma,
 		mas_set_range(mas, start, end - 1);
 	}
 #endif
+	/*
+	 * Readers under a per-VMA lock may still find the detached VMAs
+	 * through a stale RCU walk; tell them to retry the lookup.
+	 */
+	mas_set(&mas_detach, start);
+	mas_for_each(&mas_detach, tmp, end - 1)
+		vma_mark_detached(tmp, true);
+
 	/* Point of no return */
 	mas_store_prealloc(mas, NULL);
 
@@ -2828,6 +2858,8 @@ unsigned long mmap_region(struct file *file, unsigned long addr,
 			goto free_vma;
 	}
 
+	/* Lock the VMA since it is modified after insertion into VMA tree */
+	vma_start_write(vma);
 	if (vma->vm_file)
 		i_mmap_lock_write(vma->vm_file->f_mapping);
 
@@ -3094,6 +3126,7 @@ static int do_brk_flags(struct ma_state *mas, struct vm_area_struct *vma,
 		if (mas_preallocate(mas, vma, GFP_KERNEL))
 			return -ENOMEM;
 
+		vma_start_write(vma);
 		vma_adjust_trans_huge(vma, vma->vm_start, addr + len, 0);
 		if (vma->anon_vma) {
 			anon_vma_lock_write(vma->anon_vma);
@@ -3122,6 +3155,7 @@ static int do_brk_flags(struct ma_state *mas, struct vm_area_struct *vma,
 	vma->vm_pgoff = addr >> PAGE_SHIFT;
 	vma->vm_flags = flags;
 	vma->vm_page_prot = vm_get_page_prot(flags);
+	vma_start_write(vma);
 	mas_set_range(mas, vma->vm_start, addr + len - 1);
 	if (mas_store_gfp(mas, vma, GFP_KERNEL))
 		goto mas_store_fail;
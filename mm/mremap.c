@@ -605,6 +605,8 @@ static unsigned long move_vma(struct vm_area_struct *vma,
 			return err;
 	}
 
+	vma_start_write(vma);
+
 	/*
 	 * Advise KSM to break any KSM pages in the area to be moved:
 	 * it would be confusing if they were to turn up at the new
@@ -1276,6 +1276,41 @@ void page_add_new_anon_rmap(struct page *page,
 	__page_set_anon_rmap(page, vma, address, 1);
 }
 
+/**
+ * folio_add_new_anon_rmap_ptes - add PTE mappings to a new anonymous folio
+ * @folio:	the folio to add the mappings to
+ * @vma:	the vm area in which the folio is mapped
+ * @address:	the user virtual address of the first page of the folio
+ *
+ * Like page_add_new_anon_rmap(), but every page of a large folio is
+ * accounted as mapped by its own PTE, the way a THP is after its PMD
+ * has been split. Partially unmapping the folio later queues it for
+ * deferred split.
+ */
+void folio_add_new_anon_rmap_ptes(struct folio *folio,
+	struct vm_area_struct *vma, unsigned long address)
+{
+	int i, nr = folio_nr_pages(folio);
+
+	if (!folio_test_large(folio)) {
+		page_add_new_anon_rmap(&folio->page, vma, address);
+		return;
+	}
+
+	VM_BUG_ON_VMA(address < vma->vm_start ||
+		      address + nr * PAGE_SIZE > vma->vm_end, vma);
+	__folio_set_swapbacked(folio);
+	for (i = 0; i < nr; i++) {
+		struct page *page = folio_page(folio, i);
+
+		/* increment count (starts at -1) */
+		atomic_set(&page->_mapcount, 0);
+		SetPageAnonExclusive(page);
+	}
+	__lruvec_stat_mod_folio(folio, NR_ANON_MAPPED, nr);
+	__page_set_anon_rmap(&folio->page, vma, address, 1);
+}
+
 /**
  * page_add_file_rmap - add pte mapping to a file page
  * @page:	the page to add the mapping to
@@ -1333,6 +1368,42 @@ void page_add_file_rmap(struct page *page,
 	mlock_vma_page(page, vma, compound);
 }
 
+/**
+ * page_add_file_rmap_range - add pte mappings to a range of file pages
+ * @folio:	the folio the pages belong to
+ * @page:	the first page to add the mapping to
+ * @nr_pages:	the number of consecutive pages to map
+ * @vma:	the vm area in which the mappings are added
+ *
+ * Same as calling page_add_file_rmap(page + i, vma, false) for each page,
+ * but with a single memcg lock and NR_FILE_MAPPED update for the range.
+ *
+ * The caller needs to hold the pte lock.
+ */
+void page_add_file_rmap_range(struct folio *folio, struct page *page,
+	unsigned int nr_pages, struct vm_area_struct *vma)
+{
+	unsigned int i, nr = 0;
+
+	VM_BUG_ON_FOLIO(folio_page_idx(folio, page) + nr_pages >
+			folio_nr_pages(folio), folio);
+	lock_page_memcg(page);
+	if (PageTransCompound(page) && page_mapping(page)) {
+		VM_WARN_ON_ONCE(!PageLocked(page));
+		SetPageDoubleMap(compound_head(page));
+	}
+	for (i = 0; i < nr_pages; i++) {
+		if (atomic_inc_and_test(&page[i]._mapcount))
+			nr++;
+	}
+	if (nr)
+		__mod_lruvec_page_state(page, NR_FILE_MAPPED, nr);
+	unlock_page_memcg(page);
+
+	/* PTE-mapped pages of a large folio are never mlocked */
+	mlock_vma_page(page, vma, false);
+}
+
 static void page_remove_file_rmap(struct page *page, bool compound)
 {
 	int i, nr = 0;
@@ -21,7 +21,7 @@
 #include <linux/types.h>
 #include <linux/atomic.h>
 #include <linux/frontswap.h>
-#include <linux/rbtree.h>
+#include <linux/xarray.h>
 #include <linux/swap.h>
 #include <linux/crypto.h>
 #include <linux/scatterlist.h>
@@ -35,6 +35,9 @@
 #include <linux/writeback.h>
 #include <linux/pagemap.h>
 #include <linux/workqueue.h>
+#include <linux/timekeeping.h>
+#include <linux/jump_label.h>
+#include <linux/percpu.h>
 
 #include "swap.h"
 
@@ -63,6 +66,8 @@ static u64 zswap_written_back_pages;
 static u64 zswap_reject_reclaim_fail;
 /* Compressed page was too big for the allocator to (optimally) store */
 static u64 zswap_reject_compress_poor;
+/* Store skipped because recent pages of the cgroup did not compress */
+static u64 zswap_reject_incompressible;
 /* Store failed because underlying allocator could not get memory */
 static u64 zswap_reject_alloc_fail;
 /* Store failed because the entry metadata could not be allocated (rare) */
@@ -70,6 +75,22 @@ static u64 zswap_reject_kmemcache_fail;
 /* Duplicate store was encountered (rare) */
 static u64 zswap_duplicate_entry;
 
+/*
+ * Store-time histograms: compressed sizes in ZSWAP_NR_SIZE_BUCKETS linear
+ * buckets of a page, and compression latencies in power-of-two buckets of
+ * nanoseconds.  Same-filled pages don't show up here.  Only collected while
+ * the store_histograms parameter is set, and kept per cpu so that the store
+ * path doesn't bounce shared cache lines.
+ */
+#define ZSWAP_NR_SIZE_BUCKETS	16
+#define ZSWAP_NR_LAT_BUCKETS	20
+struct zswap_hist {
+	unsigned long size[ZSWAP_NR_SIZE_BUCKETS];
+	unsigned long lat[ZSWAP_NR_LAT_BUCKETS];
+};
+static DEFINE_PER_CPU(struct zswap_hist, zswap_hist);
+static DEFINE_STATIC_KEY_FALSE(zswap_hist_enabled);
+
 /* Shrinker work queue */
 static struct workqueue_struct *shrink_wq;
 /* Pool limit was hit, we need to calm down */
@@ -130,6 +151,46 @@ static bool zswap_same_filled_pages_enabled = true;
 module_param_named(same_filled_pages_enabled, zswap_same_filled_pages_enabled,
 		   bool, 0644);
 
+/*
+ * Pages compressing to this percentage of a page or more are rejected, they
+ * would cost more to keep around than they save.  Clamped to 1-100.
+ */
+static unsigned int zswap_max_compressed_percent = 100;
+static int zswap_max_compressed_percent_param_set(const char *,
+						  const struct kernel_param *);
+static const struct kernel_param_ops zswap_max_compressed_percent_param_ops = {
+	.set =		zswap_max_compressed_percent_param_set,
+	.get =		param_get_uint,
+};
+module_param_cb(max_compressed_percent,
+		&zswap_max_compressed_percent_param_ops,
+		&zswap_max_compressed_percent, 0644);
+
+/*
+ * Once this many consecutive pages of a cgroup were rejected for poor
+ * compression, only one in incompressible_sample_interval of its pages is
+ * still compressed to detect when the data becomes compressible again; the
+ * others are rejected without compressing them.  0 disables the estimator.
+ */
+static unsigned int zswap_incompressible_streak = 32;
+module_param_named(incompressible_streak, zswap_incompressible_streak,
+		   uint, 0644);
+
+static unsigned int zswap_incompressible_sample_interval = 16;
+module_param_named(incompressible_sample_interval,
+		   zswap_incompressible_sample_interval, uint, 0644);
+
+/* Enable/disable the store-time histograms in debugfs (disabled by default) */
+static bool zswap_store_histograms;
+static int zswap_store_histograms_param_set(const char *,
+					    const struct kernel_param *);
+static const struct kernel_param_ops zswap_store_histograms_param_ops = {
+	.set =		zswap_store_histograms_param_set,
+	.get =		param_get_bool,
+};
+module_param_cb(store_histograms, &zswap_store_histograms_param_ops,
+		&zswap_store_histograms, 0644);
+
 /* Enable/disable handling non-same-value filled pages (enabled by default) */
 static bool zswap_non_same_filled_pages_enabled = true;
 module_param_named(non_same_filled_pages_enabled, zswap_non_same_filled_pages_enabled,
@@ -143,8 +204,8 @@ struct crypto_acomp_ctx {
 	struct crypto_acomp *acomp;
 	struct acomp_req *req;
 	struct crypto_wait wait;
-	u8 *dstmem;
-	struct mutex *mutex;
+	u8 *buffer;
+	struct mutex mutex;
 };
 
 struct zswap_pool {
@@ -164,8 +225,7 @@ struct zswap_pool {
  * This structure contains the metadata for tracking a single compressed
  * page within zswap.
  *
- * rbnode - links the entry into red-black tree for the appropriate swap type
- * offset - the swap offset for the entry.  Index into the red-black tree.
+ * offset - the swap offset for the entry.  Index into the xarray.
  * refcount - the number of outstanding reference to the entry. This is needed
  *            to protect against premature freeing of the entry by code
  *            concurrent calls to load, invalidate, and writeback.  The lock
@@ -179,7 +239,6 @@ struct zswap_pool {
  * value - value of the same-value filled pages which have same content
  */
 struct zswap_entry {
-	struct rb_node rbnode;
 	pgoff_t offset;
 	int refcount;
 	unsigned int length;
@@ -196,16 +255,19 @@ struct zswap_header {
 };
 
 /*
- * The tree lock in the zswap_tree struct protects a few things:
- * - the rbtree
+ * Each swap type is split into one tree per SWAP_ADDRESS_SPACE_PAGES
+ * slots, the same granularity as the swap cache address spaces, so
+ * that stores and loads to different parts of a large swap device do
+ * not contend on a single lock.  The xarray lock protects:
+ * - the xarray
  * - the refcount field of each entry in the tree
  */
 struct zswap_tree {
-	struct rb_root rbroot;
-	spinlock_t lock;
+	struct xarray xarray;
 };
 
 static struct zswap_tree *zswap_trees[MAX_SWAPFILES];
+static unsigned int nr_zswap_trees[MAX_SWAPFILES];
 
 /* RCU-protected iteration */
 static LIST_HEAD(zswap_pools);
@@ -232,6 +294,7 @@ static bool zswap_has_pool;
 		 zpool_get_type((p)->zpool))
 
 static int zswap_writeback_entry(struct zpool *pool, unsigned long handle);
+static void zswap_frontswap_invalidate_page(unsigned type, pgoff_t offset);
 static int zswap_pool_get(struct zswap_pool *pool);
 static void zswap_pool_put(struct zswap_pool *pool);
 
@@ -252,6 +315,11 @@ static bool zswap_can_accept(void)
 			DIV_ROUND_UP(zswap_pool_total_size, PAGE_SIZE);
 }
 
+static struct zswap_tree *swap_zswap_tree(unsigned type, pgoff_t offset)
+{
+	return &zswap_trees[type][offset >> SWAP_ADDRESS_SPACE_SHIFT];
+}
+
 static void zswap_update_total_size(void)
 {
 	struct zswap_pool *pool;
@@ -267,6 +335,57 @@ static void zswap_update_total_size(void)
 	zswap_pool_total_size = total;
 }
 
+/*
+ * Stores without a cgroup (or with memcg kmem accounting disabled) share
+ * the root estimator.
+ */
+static atomic_t zswap_root_poor_streak = ATOMIC_INIT(0);
+
+static atomic_t *zswap_poor_streak(struct obj_cgroup *objcg)
+{
+#ifdef CONFIG_MEMCG_KMEM
+	if (objcg)
+		return &objcg->zswap_poor_streak;
+#endif
+	return &zswap_root_poor_streak;
+}
+
+/* should compression of this page be skipped as likely to fail? */
+static bool zswap_skip_incompressible(atomic_t *streak)
+{
+	unsigned int interval = READ_ONCE(zswap_incompressible_sample_interval);
+	unsigned int threshold = READ_ONCE(zswap_incompressible_streak);
+	int nr = atomic_read(streak);
+
+	if (!threshold || nr < threshold)
+		return false;
+
+	/* count skipped pages past the threshold to pick the samples */
+	nr = atomic_inc_return(streak) - threshold;
+	return interval > 1 && nr % interval;
+}
+
+static void zswap_update_poor_streak(atomic_t *streak, bool poor)
+{
+	if (poor)
+		atomic_inc(streak);
+	else if (atomic_read(streak))
+		atomic_set(streak, 0);
+}
+
+static void zswap_store_hist(unsigned int dlen, u64 nsecs)
+{
+	unsigned int bucket;
+
+	bucket = min_t(unsigned int, dlen * ZSWAP_NR_SIZE_BUCKETS / PAGE_SIZE,
+		       ZSWAP_NR_SIZE_BUCKETS - 1);
+	this_cpu_inc(zswap_hist.size[bucket]);
+
+	bucket = min_t(unsigned int, nsecs ? ilog2(nsecs) : 0,
+		       ZSWAP_NR_LAT_BUCKETS - 1);
+	this_cpu_inc(zswap_hist.lat[bucket]);
+}
+
 /*********************************
 * zswap entry functions
 **********************************/
@@ -290,7 +409,6 @@ static struct zswap_entry *zswap_entry_cache_alloc(gfp_t gfp)
 	if (!entry)
 		return NULL;
 	entry->refcount = 1;
-	RB_CLEAR_NODE(&entry->rbnode);
 	return entry;
 }
 
@@ -300,58 +418,13 @@ static void zswap_entry_cache_free(struct zswap_entry *entry)
 }
 
 /*********************************
-* rbtree functions
+* xarray functions
 **********************************/
-static struct zswap_entry *zswap_rb_search(struct rb_root *root, pgoff_t offset)
-{
-	struct rb_node *node = root->rb_node;
-	struct zswap_entry *entry;
-
-	while (node) {
-		entry = rb_entry(node, struct zswap_entry, rbnode);
-		if (entry->offset > offset)
-			node = node->rb_left;
-		else if (entry->offset < offset)
-			node = node->rb_right;
-		else
-			return entry;
-	}
-	return NULL;
-}
-
-/*
- * In the case that a entry with the same offset is found, a pointer to
- * the existing entry is stored in dupentry and the function returns -EEXIST
- */
-static int zswap_rb_insert(struct rb_root *root, struct zswap_entry *entry,
-			struct zswap_entry **dupentry)
-{
-	struct rb_node **link = &root->rb_node, *parent = NULL;
-	struct zswap_entry *myentry;
-
-	while (*link) {
-		parent = *link;
-		myentry = rb_entry(parent, struct zswap_entry, rbnode);
-		if (myentry->offset > entry->offset)
-			link = &(*link)->rb_left;
-		else if (myentry->offset < entry->offset)
-			link = &(*link)->rb_right;
-		else {
-			*dupentry = myentry;
-			return -EEXIST;
-		}
-	}
-	rb_link_node(&entry->rbnode, parent, link);
-	rb_insert_color(&entry->rbnode, root);
-	return 0;
-}
-
-static void zswap_rb_erase(struct rb_root *root, struct zswap_entry *entry)
+/* caller must hold the tree lock */
+static void zswap_xa_erase(struct zswap_tree *tree, struct zswap_entry *entry)
 {
-	if (!RB_EMPTY_NODE(&entry->rbnode)) {
-		rb_erase(&entry->rbnode, root);
-		RB_CLEAR_NODE(&entry->rbnode);
-	}
+	/* only drop the slot if it still points at this entry */
+	__xa_cmpxchg(&tree->xarray, entry->offset, entry, NULL, 0);
 }
 
 /*
@@ -391,18 +464,18 @@ static void zswap_entry_put(struct zswap_tree *tree,
 
 	BUG_ON(refcount < 0);
 	if (refcount == 0) {
-		zswap_rb_erase(&tree->rbroot, entry);
+		zswap_xa_erase(tree, entry);
 		zswap_free_entry(entry);
 	}
 }
 
 /* caller must hold the tree lock */
-static struct zswap_entry *zswap_entry_find_get(struct rb_root *root,
+static struct zswap_entry *zswap_entry_find_get(struct zswap_tree *tree,
 				pgoff_t offset)
 {
 	struct zswap_entry *entry;
 
-	entry = zswap_rb_search(root, offset);
+	entry = xa_load(&tree->xarray, offset);
 	if (entry)
 		zswap_entry_get(entry);
 
@@ -412,62 +485,24 @@ static struct zswap_entry *zswap_entry_find_get(struct rb_root *root,
 /*********************************
 * per-cpu code
 **********************************/
-static DEFINE_PER_CPU(u8 *, zswap_dstmem);
-/*
- * If users dynamically change the zpool type and compressor at runtime, i.e.
- * zswap is running, zswap can have more than one zpool on one cpu, but they
- * are sharing dtsmem. So we need this mutex to be per-cpu.
- */
-static DEFINE_PER_CPU(struct mutex *, zswap_mutex);
-
-static int zswap_dstmem_prepare(unsigned int cpu)
-{
-	struct mutex *mutex;
-	u8 *dst;
-
-	dst = kmalloc_node(PAGE_SIZE * 2, GFP_KERNEL, cpu_to_node(cpu));
-	if (!dst)
-		return -ENOMEM;
-
-	mutex = kmalloc_node(sizeof(*mutex), GFP_KERNEL, cpu_to_node(cpu));
-	if (!mutex) {
-		kfree(dst);
-		return -ENOMEM;
-	}
-
-	mutex_init(mutex);
-	per_cpu(zswap_dstmem, cpu) = dst;
-	per_cpu(zswap_mutex, cpu) = mutex;
-	return 0;
-}
-
-static int zswap_dstmem_dead(unsigned int cpu)
-{
-	struct mutex *mutex;
-	u8 *dst;
-
-	mutex = per_cpu(zswap_mutex, cpu);
-	kfree(mutex);
-	per_cpu(zswap_mutex, cpu) = NULL;
-
-	dst = per_cpu(zswap_dstmem, cpu);
-	kfree(dst);
-	per_cpu(zswap_dstmem, cpu) = NULL;
-
-	return 0;
-}
-
 static int zswap_cpu_comp_prepare(unsigned int cpu, struct hlist_node *node)
 {
 	struct zswap_pool *pool = hlist_entry(node, struct zswap_pool, node);
 	struct crypto_acomp_ctx *acomp_ctx = per_cpu_ptr(pool->acomp_ctx, cpu);
 	struct crypto_acomp *acomp;
 	struct acomp_req *req;
+	u8 *buffer;
+
+	/* the compressed output may be larger than the page, see store */
+	buffer = kmalloc_node(PAGE_SIZE * 2, GFP_KERNEL, cpu_to_node(cpu));
+	if (!buffer)
+		return -ENOMEM;
 
 	acomp = crypto_alloc_acomp_node(pool->tfm_name, 0, 0, cpu_to_node(cpu));
 	if (IS_ERR(acomp)) {
 		pr_err("could not alloc crypto acomp %s : %ld\n",
 				pool->tfm_name, PTR_ERR(acomp));
+		kfree(buffer);
 		return PTR_ERR(acomp);
 	}
 	acomp_ctx->acomp = acomp;
@@ -477,6 +512,7 @@ static int zswap_cpu_comp_prepare(unsigned int cpu, struct hlist_node *node)
 		pr_err("could not alloc crypto acomp_request %s\n",
 		       pool->tfm_name);
 		crypto_free_acomp(acomp_ctx->acomp);
+		kfree(buffer);
 		return -ENOMEM;
 	}
 	acomp_ctx->req = req;
@@ -490,8 +526,14 @@ static int zswap_cpu_comp_prepare(unsigned int cpu, struct hlist_node *node)
 	acomp_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
 				   crypto_req_done, &acomp_ctx->wait);
 
-	acomp_ctx->mutex = per_cpu(zswap_mutex, cpu);
-	acomp_ctx->dstmem = per_cpu(zswap_dstmem, cpu);
+	/*
+	 * The buffer and mutex belong to this pool's context alone, so pools
+	 * created by runtime compressor or zpool changes never serialize
+	 * against each other.  The mutex is still needed because the task
+	 * may migrate after picking its context with raw_cpu_ptr().
+	 */
+	mutex_init(&acomp_ctx->mutex);
+	acomp_ctx->buffer = buffer;
 
 	return 0;
 }
@@ -506,6 +548,7 @@ static int zswap_cpu_comp_dead(unsigned int cpu, struct hlist_node *node)
 			acomp_request_free(acomp_ctx->req);
 		if (!IS_ERR_OR_NULL(acomp_ctx->acomp))
 			crypto_free_acomp(acomp_ctx->acomp);
+		kfree(acomp_ctx->buffer);
 	}
 
 	return 0;
@@ -887,6 +930,35 @@ static int zswap_enabled_param_set(const char *val,
 	return param_set_bool(val, kp);
 }
 
+static int zswap_max_compressed_percent_param_set(const char *val,
+						  const struct kernel_param *kp)
+{
+	unsigned int percent;
+	int ret;
+
+	ret = kstrtouint(val, 0, &percent);
+	if (ret)
+		return ret;
+
+	*(unsigned int *)kp->arg = clamp_val(percent, 1, 100);
+	return 0;
+}
+
+static int zswap_store_histograms_param_set(const char *val,
+					    const struct kernel_param *kp)
+{
+	int ret = param_set_bool(val, kp);
+
+	if (ret)
+		return ret;
+
+	if (zswap_store_histograms)
+		static_branch_enable(&zswap_hist_enabled);
+	else
+		static_branch_disable(&zswap_hist_enabled);
+	return 0;
+}
+
 /*********************************
 * writeback code
 **********************************/
@@ -966,20 +1038,20 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 	/* extract swpentry from data */
 	zhdr = zpool_map_handle(pool, handle, ZPOOL_MM_RO);
 	swpentry = zhdr->swpentry; /* here */
-	tree = zswap_trees[swp_type(swpentry)];
 	offset = swp_offset(swpentry);
+	tree = swap_zswap_tree(swp_type(swpentry), offset);
 
 	/* find and ref zswap entry */
-	spin_lock(&tree->lock);
-	entry = zswap_entry_find_get(&tree->rbroot, offset);
+	xa_lock(&tree->xarray);
+	entry = zswap_entry_find_get(tree, offset);
 	if (!entry) {
 		/* entry was invalidated */
-		spin_unlock(&tree->lock);
+		xa_unlock(&tree->xarray);
 		zpool_unmap_handle(pool, handle);
 		kfree(tmp);
 		return 0;
 	}
-	spin_unlock(&tree->lock);
+	xa_unlock(&tree->xarray);
 	BUG_ON(offset != entry->offset);
 
 	src = (u8 *)zhdr + sizeof(struct zswap_header);
@@ -1009,29 +1081,29 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 		 * from the slot, recheck that the entry is still current before
 		 * writing.
 		 */
-		spin_lock(&tree->lock);
-		if (zswap_rb_search(&tree->rbroot, entry->offset) != entry) {
-			spin_unlock(&tree->lock);
+		xa_lock(&tree->xarray);
+		if (xa_load(&tree->xarray, entry->offset) != entry) {
+			xa_unlock(&tree->xarray);
 			delete_from_swap_cache(page_folio(page));
 			unlock_page(page);
 			put_page(page);
 			ret = -ENOMEM;
 			goto fail;
 		}
-		spin_unlock(&tree->lock);
+		xa_unlock(&tree->xarray);
 
 		/* decompress */
 		acomp_ctx = raw_cpu_ptr(entry->pool->acomp_ctx);
 		dlen = PAGE_SIZE;
 
-		mutex_lock(acomp_ctx->mutex);
+		mutex_lock(&acomp_ctx->mutex);
 		sg_init_one(&input, src, entry->length);
 		sg_init_table(&output, 1);
 		sg_set_page(&output, page, PAGE_SIZE, 0);
 		acomp_request_set_params(acomp_ctx->req, &input, &output, entry->length, dlen);
 		ret = crypto_wait_req(crypto_acomp_decompress(acomp_ctx->req), &acomp_ctx->wait);
 		dlen = acomp_ctx->req->dlen;
-		mutex_unlock(acomp_ctx->mutex);
+		mutex_unlock(&acomp_ctx->mutex);
 
 		BUG_ON(ret);
 		BUG_ON(dlen != PAGE_SIZE);
@@ -1048,7 +1120,7 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 	put_page(page);
 	zswap_written_back_pages++;
 
-	spin_lock(&tree->lock);
+	xa_lock(&tree->xarray);
 	/* drop local reference */
 	zswap_entry_put(tree, entry);
 
@@ -1059,9 +1131,9 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 	*     because invalidate happened during writeback
 	*  search the tree and free the entry if find entry
 	*/
-	if (entry == zswap_rb_search(&tree->rbroot, offset))
+	if (entry == xa_load(&tree->xarray, offset))
 		zswap_entry_put(tree, entry);
-	spin_unlock(&tree->lock);
+	xa_unlock(&tree->xarray);
 
 	goto end;
 
@@ -1073,9 +1145,9 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 	* it is also okay to return !0
 	*/
 fail:
-	spin_lock(&tree->lock);
+	xa_lock(&tree->xarray);
 	zswap_entry_put(tree, entry);
-	spin_unlock(&tree->lock);
+	xa_unlock(&tree->xarray);
 
 end:
 	if (zpool_can_sleep_mapped(pool))
@@ -1088,15 +1160,26 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 
 static int zswap_is_page_same_filled(void *ptr, unsigned long *value)
 {
-	unsigned int pos;
-	unsigned long *page;
+	unsigned long *page = ptr;
+	unsigned long val = page[0];
+	unsigned int pos, last_pos = PAGE_SIZE / sizeof(*page) - 1;
 
-	page = (unsigned long *)ptr;
-	for (pos = 1; pos < PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos] != page[0])
+	/* most pages differ somewhere, try the far end before the scan */
+	if (page[last_pos] != val)
+		return 0;
+
+	/*
+	 * Fold four words per iteration into one test to keep the loop
+	 * branch-light.  The vector unit isn't worth it here: claiming it
+	 * saves the task's vector state, which costs more than this scan
+	 * that usually bails out on the first or last word.
+	 */
+	for (pos = 0; pos <= last_pos; pos += 4) {
+		if ((page[pos] ^ val) | (page[pos + 1] ^ val) |
+		    (page[pos + 2] ^ val) | (page[pos + 3] ^ val))
 			return 0;
 	}
-	*value = page[0];
+	*value = val;
 	return 1;
 }
 
@@ -1111,74 +1194,40 @@ static void zswap_fill_page(void *ptr, unsigned long value)
 /*********************************
 * frontswap hooks
 **********************************/
-/* attempts to compress and store an single page */
-static int zswap_frontswap_store(unsigned type, pgoff_t offset,
-				struct page *page)
+/*
+ * Compresses and inserts a single page.  The caller holds a reference on
+ * @pool (NULL if non-same-filled pages can't be stored) and the mutex of
+ * @acomp_ctx, and keeps both across all pages of a folio.
+ */
+static int zswap_store_page(unsigned type, pgoff_t offset, struct page *page,
+			    struct obj_cgroup *objcg, struct zswap_pool *pool,
+			    struct crypto_acomp_ctx *acomp_ctx)
 {
-	struct zswap_tree *tree = zswap_trees[type];
+	struct zswap_tree *tree = swap_zswap_tree(type, offset);
 	struct zswap_entry *entry, *dupentry;
 	struct scatterlist input, output;
-	struct crypto_acomp_ctx *acomp_ctx;
-	struct obj_cgroup *objcg = NULL;
-	struct zswap_pool *pool;
 	int ret;
 	unsigned int hlen, dlen = PAGE_SIZE;
 	unsigned long handle, value;
 	char *buf;
 	u8 *src, *dst;
 	struct zswap_header zhdr = { .swpentry = swp_entry(type, offset) };
+	atomic_t *streak = zswap_poor_streak(objcg);
+	u64 start = 0;
+	bool hist;
 	gfp_t gfp;
 
-	/* THP isn't supported */
-	if (PageTransHuge(page)) {
-		ret = -EINVAL;
-		goto reject;
-	}
-
-	if (!zswap_enabled || !tree) {
-		ret = -ENODEV;
-		goto reject;
-	}
-
-	/*
-	 * XXX: zswap reclaim does not work with cgroups yet. Without a
-	 * cgroup-aware entry LRU, we will push out entries system-wide based on
-	 * local cgroup limits.
-	 */
-	objcg = get_obj_cgroup_from_page(page);
-	if (objcg && !obj_cgroup_may_zswap(objcg)) {
-		ret = -ENOMEM;
-		goto reject;
-	}
-
-	/* reclaim space if needed */
-	if (zswap_is_full()) {
-		zswap_pool_limit_hit++;
-		zswap_pool_reached_full = true;
-		goto shrink;
-	}
-
-	if (zswap_pool_reached_full) {
-	       if (!zswap_can_accept()) {
-			ret = -ENOMEM;
-			goto reject;
-		} else
-			zswap_pool_reached_full = false;
-	}
-
 	/* allocate entry */
 	entry = zswap_entry_cache_alloc(GFP_KERNEL);
 	if (!entry) {
 		zswap_reject_kmemcache_fail++;
-		ret = -ENOMEM;
-		goto reject;
+		return -ENOMEM;
 	}
 
 	if (zswap_same_filled_pages_enabled) {
 		src = kmap_atomic(page);
 		if (zswap_is_page_same_filled(src, &value)) {
 			kunmap_atomic(src);
-			entry->offset = offset;
 			entry->length = 0;
 			entry->value = value;
 			atomic_inc(&zswap_same_filled_pages);
@@ -1187,28 +1236,23 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 		kunmap_atomic(src);
 	}
 
-	if (!zswap_non_same_filled_pages_enabled) {
+	if (!pool) {
 		ret = -EINVAL;
 		goto freepage;
 	}
 
-	/* if entry is successfully added, it keeps the reference */
-	entry->pool = zswap_pool_current_get();
-	if (!entry->pool) {
+	if (zswap_skip_incompressible(streak)) {
+		zswap_reject_incompressible++;
 		ret = -EINVAL;
 		goto freepage;
 	}
 
 	/* compress */
-	acomp_ctx = raw_cpu_ptr(entry->pool->acomp_ctx);
-
-	mutex_lock(acomp_ctx->mutex);
-
-	dst = acomp_ctx->dstmem;
+	dst = acomp_ctx->buffer;
 	sg_init_table(&input, 1);
 	sg_set_page(&input, page, PAGE_SIZE, 0);
 
-	/* zswap_dstmem is of size (PAGE_SIZE * 2). Reflect same in sg_list */
+	/* the buffer is of size (PAGE_SIZE * 2). Reflect same in sg_list */
 	sg_init_one(&output, dst, PAGE_SIZE * 2);
 	acomp_request_set_params(acomp_ctx->req, &input, &output, PAGE_SIZE, dlen);
 	/*
@@ -1223,72 +1267,167 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 	 * but in different threads running on different cpu, we have different
 	 * acomp instance, so multiple threads can do (de)compression in parallel.
 	 */
+	/* Sampled once, the key may flip while compressing */
+	hist = static_branch_unlikely(&zswap_hist_enabled);
+	if (hist)
+		start = ktime_get_ns();
 	ret = crypto_wait_req(crypto_acomp_compress(acomp_ctx->req), &acomp_ctx->wait);
 	dlen = acomp_ctx->req->dlen;
 
 	if (ret) {
+		zswap_update_poor_streak(streak, true);
 		ret = -EINVAL;
-		goto put_dstmem;
+		goto freepage;
 	}
+	if (hist)
+		zswap_store_hist(dlen, ktime_get_ns() - start);
+
+	if (dlen * 100 >= PAGE_SIZE * zswap_max_compressed_percent) {
+		zswap_update_poor_streak(streak, true);
+		zswap_reject_compress_poor++;
+		ret = -ENOSPC;
+		goto freepage;
+	}
+	zswap_update_poor_streak(streak, false);
 
 	/* store */
-	hlen = zpool_evictable(entry->pool->zpool) ? sizeof(zhdr) : 0;
+	hlen = zpool_evictable(pool->zpool) ? sizeof(zhdr) : 0;
 	gfp = __GFP_NORETRY | __GFP_NOWARN | __GFP_KSWAPD_RECLAIM;
-	if (zpool_malloc_support_movable(entry->pool->zpool))
+	if (zpool_malloc_support_movable(pool->zpool))
 		gfp |= __GFP_HIGHMEM | __GFP_MOVABLE;
-	ret = zpool_malloc(entry->pool->zpool, hlen + dlen, gfp, &handle);
+	ret = zpool_malloc(pool->zpool, hlen + dlen, gfp, &handle);
 	if (ret == -ENOSPC) {
 		zswap_reject_compress_poor++;
-		goto put_dstmem;
+		goto freepage;
 	}
 	if (ret) {
 		zswap_reject_alloc_fail++;
-		goto put_dstmem;
+		goto freepage;
 	}
-	buf = zpool_map_handle(entry->pool->zpool, handle, ZPOOL_MM_WO);
+	buf = zpool_map_handle(pool->zpool, handle, ZPOOL_MM_WO);
 	memcpy(buf, &zhdr, hlen);
 	memcpy(buf + hlen, dst, dlen);
-	zpool_unmap_handle(entry->pool->zpool, handle);
-	mutex_unlock(acomp_ctx->mutex);
+	zpool_unmap_handle(pool->zpool, handle);
 
-	/* populate entry */
-	entry->offset = offset;
+	/* populate entry; the caller's reference keeps the pool alive */
+	kref_get(&pool->kref);
+	entry->pool = pool;
 	entry->handle = handle;
 	entry->length = dlen;
 
 insert_entry:
+	entry->offset = offset;
 	entry->objcg = objcg;
 	if (objcg) {
+		obj_cgroup_get(objcg);
 		obj_cgroup_charge_zswap(objcg, entry->length);
 		/* Account before objcg ref is moved to tree */
 		count_objcg_event(objcg, ZSWPOUT);
 	}
+	atomic_inc(&zswap_stored_pages);
 
 	/* map */
-	spin_lock(&tree->lock);
-	do {
-		ret = zswap_rb_insert(&tree->rbroot, entry, &dupentry);
-		if (ret == -EEXIST) {
-			zswap_duplicate_entry++;
-			/* remove from rbtree */
-			zswap_rb_erase(&tree->rbroot, dupentry);
-			zswap_entry_put(tree, dupentry);
-		}
-	} while (ret == -EEXIST);
-	spin_unlock(&tree->lock);
+	xa_lock(&tree->xarray);
+	dupentry = __xa_store(&tree->xarray, offset, entry, GFP_KERNEL);
+	if (xa_is_err(dupentry)) {
+		xa_unlock(&tree->xarray);
+		zswap_reject_alloc_fail++;
+		zswap_free_entry(entry);
+		return xa_err(dupentry);
+	}
+	if (dupentry) {
+		zswap_duplicate_entry++;
+		/* already replaced in the xarray, drop the initial reference */
+		zswap_entry_put(tree, dupentry);
+	}
+	xa_unlock(&tree->xarray);
 
-	/* update stats */
-	atomic_inc(&zswap_stored_pages);
-	zswap_update_total_size();
 	count_vm_event(ZSWPOUT);
 
 	return 0;
 
-put_dstmem:
-	mutex_unlock(acomp_ctx->mutex);
-	zswap_pool_put(entry->pool);
 freepage:
 	zswap_entry_cache_free(entry);
+	return ret;
+}
+
+/*
+ * attempts to compress and store a single page, or all pages of a large
+ * folio.  A folio is stored completely or not at all.
+ */
+static int zswap_frontswap_store(unsigned type, pgoff_t offset,
+				struct page *page)
+{
+	long i, nr_pages = compound_nr(page);
+	struct crypto_acomp_ctx *acomp_ctx = NULL;
+	struct obj_cgroup *objcg = NULL;
+	struct zswap_pool *pool = NULL;
+	int ret = 0;
+
+	if (!zswap_enabled || !zswap_trees[type]) {
+		ret = -ENODEV;
+		goto reject;
+	}
+
+	/*
+	 * XXX: zswap reclaim does not work with cgroups yet. Without a
+	 * cgroup-aware entry LRU, we will push out entries system-wide based on
+	 * local cgroup limits.
+	 */
+	objcg = get_obj_cgroup_from_page(page);
+	if (objcg && !obj_cgroup_may_zswap(objcg)) {
+		ret = -ENOMEM;
+		goto reject;
+	}
+
+	/* reclaim space if needed */
+	if (zswap_is_full()) {
+		zswap_pool_limit_hit++;
+		zswap_pool_reached_full = true;
+		goto shrink;
+	}
+
+	if (zswap_pool_reached_full) {
+	       if (!zswap_can_accept()) {
+			ret = -ENOMEM;
+			goto reject;
+		} else
+			zswap_pool_reached_full = false;
+	}
+
+	/*
+	 * Take the pool and the compression context once for the whole
+	 * folio rather than once per page.
+	 */
+	if (zswap_non_same_filled_pages_enabled)
+		pool = zswap_pool_current_get();
+	if (pool) {
+		acomp_ctx = raw_cpu_ptr(pool->acomp_ctx);
+		mutex_lock(&acomp_ctx->mutex);
+	}
+
+	for (i = 0; i < nr_pages; i++) {
+		ret = zswap_store_page(type, offset + i, page + i, objcg,
+				       pool, acomp_ctx);
+		if (ret)
+			break;
+	}
+
+	if (pool) {
+		mutex_unlock(&acomp_ctx->mutex);
+		zswap_pool_put(pool);
+	}
+
+	/* a partially stored folio is of no use, it all goes to swap */
+	if (ret) {
+		while (i--)
+			zswap_frontswap_invalidate_page(type, offset + i);
+		goto reject;
+	}
+
+	/* update stats */
+	zswap_update_total_size();
+
 reject:
 	if (objcg)
 		obj_cgroup_put(objcg);
@@ -1309,7 +1448,7 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 				struct page *page)
 {
-	struct zswap_tree *tree = zswap_trees[type];
+	struct zswap_tree *tree = swap_zswap_tree(type, offset);
 	struct zswap_entry *entry;
 	struct scatterlist input, output;
 	struct crypto_acomp_ctx *acomp_ctx;
@@ -1318,14 +1457,14 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 	int ret;
 
 	/* find */
-	spin_lock(&tree->lock);
-	entry = zswap_entry_find_get(&tree->rbroot, offset);
+	xa_lock(&tree->xarray);
+	entry = zswap_entry_find_get(tree, offset);
 	if (!entry) {
 		/* entry was written back */
-		spin_unlock(&tree->lock);
+		xa_unlock(&tree->xarray);
 		return -1;
 	}
-	spin_unlock(&tree->lock);
+	xa_unlock(&tree->xarray);
 
 	if (!entry->length) {
 		dst = kmap_atomic(page);
@@ -1356,13 +1495,13 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 	}
 
 	acomp_ctx = raw_cpu_ptr(entry->pool->acomp_ctx);
-	mutex_lock(acomp_ctx->mutex);
+	mutex_lock(&acomp_ctx->mutex);
 	sg_init_one(&input, src, entry->length);
 	sg_init_table(&output, 1);
 	sg_set_page(&output, page, PAGE_SIZE, 0);
 	acomp_request_set_params(acomp_ctx->req, &input, &output, entry->length, dlen);
 	ret = crypto_wait_req(crypto_acomp_decompress(acomp_ctx->req), &acomp_ctx->wait);
-	mutex_unlock(acomp_ctx->mutex);
+	mutex_unlock(&acomp_ctx->mutex);
 
 	if (zpool_can_sleep_mapped(entry->pool->zpool))
 		zpool_unmap_handle(entry->pool->zpool, entry->handle);
@@ -1375,9 +1514,9 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 	if (entry->objcg)
 		count_objcg_event(entry->objcg, ZSWPIN);
 freeentry:
-	spin_lock(&tree->lock);
+	xa_lock(&tree->xarray);
 	zswap_entry_put(tree, entry);
-	spin_unlock(&tree->lock);
+	xa_unlock(&tree->xarray);
 
 	return ret;
 }
@@ -1385,59 +1524,65 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 /* frees an entry in zswap */
 static void zswap_frontswap_invalidate_page(unsigned type, pgoff_t offset)
 {
-	struct zswap_tree *tree = zswap_trees[type];
+	struct zswap_tree *tree = swap_zswap_tree(type, offset);
 	struct zswap_entry *entry;
 
-	/* find */
-	spin_lock(&tree->lock);
-	entry = zswap_rb_search(&tree->rbroot, offset);
+	/* find and remove from the xarray */
+	xa_lock(&tree->xarray);
+	entry = __xa_erase(&tree->xarray, offset);
 	if (!entry) {
 		/* entry was written back */
-		spin_unlock(&tree->lock);
+		xa_unlock(&tree->xarray);
 		return;
 	}
 
-	/* remove from rbtree */
-	zswap_rb_erase(&tree->rbroot, entry);
-
 	/* drop the initial reference from entry creation */
 	zswap_entry_put(tree, entry);
 
-	spin_unlock(&tree->lock);
+	xa_unlock(&tree->xarray);
 }
 
 /* frees all zswap entries for the given swap type */
 static void zswap_frontswap_invalidate_area(unsigned type)
 {
-	struct zswap_tree *tree = zswap_trees[type];
-	struct zswap_entry *entry, *n;
+	struct zswap_tree *trees = zswap_trees[type];
+	struct zswap_entry *entry;
+	unsigned long offset;
+	unsigned int i;
 
-	if (!tree)
+	if (!trees)
 		return;
 
-	/* walk the tree and free everything */
-	spin_lock(&tree->lock);
-	rbtree_postorder_for_each_entry_safe(entry, n, &tree->rbroot, rbnode)
-		zswap_free_entry(entry);
-	tree->rbroot = RB_ROOT;
-	spin_unlock(&tree->lock);
-	kfree(tree);
+	/* walk the trees and free everything */
+	for (i = 0; i < nr_zswap_trees[type]; i++) {
+		xa_lock(&trees[i].xarray);
+		xa_for_each(&trees[i].xarray, offset, entry)
+			zswap_free_entry(entry);
+		xa_unlock(&trees[i].xarray);
+		xa_destroy(&trees[i].xarray);
+	}
+	kvfree(trees);
+	nr_zswap_trees[type] = 0;
 	zswap_trees[type] = NULL;
 }
 
 static void zswap_frontswap_init(unsigned type)
 {
-	struct zswap_tree *tree;
+	struct swap_info_struct *sis = swp_swap_info(swp_entry(type, 0));
+	struct zswap_tree *trees;
+	unsigned int nr, i;
 
-	tree = kzalloc(sizeof(*tree), GFP_KERNEL);
-	if (!tree) {
+	nr = DIV_ROUND_UP(sis->max, SWAP_ADDRESS_SPACE_PAGES);
+	trees = kvcalloc(nr, sizeof(*trees), GFP_KERNEL);
+	if (!trees) {
 		pr_err("alloc failed, zswap disabled for swap type %d\n", type);
 		return;
 	}
 
-	tree->rbroot = RB_ROOT;
-	spin_lock_init(&tree->lock);
-	zswap_trees[type] = tree;
+	for (i = 0; i < nr; i++)
+		xa_init(&trees[i].xarray);
+	nr_zswap_trees[type] = nr;
+	zswap_trees[type] = trees;
 }
 
 static const struct frontswap_ops zswap_frontswap_ops = {
@@ -1453,9 +1598,42 @@ static const struct frontswap_ops zswap_frontswap_ops = {
 **********************************/
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 static struct dentry *zswap_debugfs_root;
 
+static int zswap_hist_show(struct seq_file *m, void *v)
+{
+	struct zswap_hist sum = {};
+	unsigned int i;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct zswap_hist *hist = per_cpu_ptr(&zswap_hist, cpu);
+
+		for (i = 0; i < ZSWAP_NR_SIZE_BUCKETS; i++)
+			sum.size[i] += READ_ONCE(hist->size[i]);
+		for (i = 0; i < ZSWAP_NR_LAT_BUCKETS; i++)
+			sum.lat[i] += READ_ONCE(hist->lat[i]);
+	}
+
+	seq_puts(m, "compressed size (bytes)\n");
+	for (i = 0; i < ZSWAP_NR_SIZE_BUCKETS; i++)
+		seq_printf(m, "%5lu-%-5lu %lu\n",
+			   i * PAGE_SIZE / ZSWAP_NR_SIZE_BUCKETS,
+			   (i + 1) * PAGE_SIZE / ZSWAP_NR_SIZE_BUCKETS - 1,
+			   sum.size[i]);
+
+	seq_puts(m, "compression time (ns)\n");
+	for (i = 0; i < ZSWAP_NR_LAT_BUCKETS; i++)
+		seq_printf(m, "%s%-10lu %lu\n",
+			   i == ZSWAP_NR_LAT_BUCKETS - 1 ? ">=" : "< ",
+			   i == ZSWAP_NR_LAT_BUCKETS - 1 ? 1UL << i : 2UL << i,
+			   sum.lat[i]);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(zswap_hist);
+
 static int __init zswap_debugfs_init(void)
 {
 	if (!debugfs_initialized())
@@ -1473,6 +1651,8 @@ static int __init zswap_debugfs_init(void)
 			   zswap_debugfs_root, &zswap_reject_kmemcache_fail);
 	debugfs_create_u64("reject_compress_poor", 0444,
 			   zswap_debugfs_root, &zswap_reject_compress_poor);
+	debugfs_create_u64("reject_incompressible", 0444,
+			   zswap_debugfs_root, &zswap_reject_incompressible);
 	debugfs_create_u64("written_back_pages", 0444,
 			   zswap_debugfs_root, &zswap_written_back_pages);
 	debugfs_create_u64("duplicate_entry", 0444,
@@ -1483,6 +1663,8 @@ static int __init zswap_debugfs_init(void)
 				zswap_debugfs_root, &zswap_stored_pages);
 	debugfs_create_atomic_t("same_filled_pages", 0444,
 				zswap_debugfs_root, &zswap_same_filled_pages);
+	debugfs_create_file("store_histograms", 0444, zswap_debugfs_root,
+			    NULL, &zswap_hist_fops);
 
 	return 0;
 }
@@ -1508,13 +1690,6 @@ static int __init init_zswap(void)
 		goto cache_fail;
 	}
 
-	ret = cpuhp_setup_state(CPUHP_MM_ZSWP_MEM_PREPARE, "mm/zswap:prepare",
-				zswap_dstmem_prepare, zswap_dstmem_dead);
-	if (ret) {
-		pr_err("dstmem alloc failed\n");
-		goto dstmem_fail;
-	}
-
 	ret = cpuhp_setup_state_multi(CPUHP_MM_ZSWP_POOL_PREPARE,
 				      "mm/zswap_pool:prepare",
 				      zswap_cpu_comp_prepare,
@@ -1550,8 +1725,6 @@ static int __init init_zswap(void)
 	if (pool)
 		zswap_pool_destroy(pool);
 hp_fail:
-	cpuhp_remove_state(CPUHP_MM_ZSWP_MEM_PREPARE);
-dstmem_fail:
 	zswap_entry_cache_destroy();
 cache_fail:
 	/* if built-in, we aren't unloaded on failure; don't allow use */
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * vdso_test_bench.c: Compare the cost of the vDSO entry points with the
+ * system calls they replace.
+ *
+ * For getcpu, the cpu_id glibc keeps in the registered rseq area is
+ * measured as well: on architectures whose vDSO getcpu has no way to
+ * find the current CPU (RISC-V) that is the fast path.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "../kselftest.h"
+
+#ifndef CLOCK_TAI
+#define CLOCK_TAI 11
+#endif
+
+#define NR_LOOPS	1000000
+
+typedef long (*vgetcpu_t)(unsigned int *cpu, unsigned int *node, void *cache);
+typedef int (*vgettime_t)(clockid_t clk, struct timespec *ts);
+
+/* Exported by glibc >= 2.35 when it registered rseq for the thread */
+extern const ptrdiff_t __rseq_offset __attribute__((weak));
+extern const unsigned int __rseq_size __attribute__((weak));
+
+static vgetcpu_t vdso_getcpu;
+static vgettime_t vdso_clock_gettime;
+static vgettime_t vdso_clock_getres;
+
+static void *vdso_sym(void *vdso, const char *name, const char *alt)
+{
+	void *sym = dlsym(vdso, name);
+
+	if (!sym && alt)
+		sym = dlsym(vdso, alt);
+	return sym;
+}
+
+static void fill_function_pointers(void)
+{
+	void *vdso = dlopen("linux-vdso.so.1",
+			    RTLD_LAZY | RTLD_LOCAL | RTLD_NOLOAD);
+
+	if (!vdso)
+		vdso = dlopen("linux-gate.so.1",
+			      RTLD_LAZY | RTLD_LOCAL | RTLD_NOLOAD);
+	if (!vdso) {
+		ksft_print_msg("[WARN]\tfailed to find vDSO\n");
+		return;
+	}
+
+	vdso_getcpu = vdso_sym(vdso, "__vdso_getcpu", "__kernel_getcpu");
+	vdso_clock_gettime = vdso_sym(vdso, "__vdso_clock_gettime",
+				      "__kernel_clock_gettime");
+	vdso_clock_getres = vdso_sym(vdso, "__vdso_clock_getres",
+				     "__kernel_clock_getres");
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *what, uint64_t start)
+{
+	uint64_t delta = now_ns() - start;
+
+	ksft_print_msg("%-42s %8.1f ns/call\n", what,
+		       (double)delta / NR_LOOPS);
+}
+
+static void bench_getcpu(void)
+{
+	unsigned int cpu, node;
+	uint64_t start;
+	int i;
+
+	start = now_ns();
+	for (i = 0; i < NR_LOOPS; i++)
+		syscall(__NR_getcpu, &cpu, &node, NULL);
+	report("getcpu: syscall", start);
+
+	if (vdso_getcpu) {
+		start = now_ns();
+		for (i = 0; i < NR_LOOPS; i++)
+			vdso_getcpu(&cpu, &node, NULL);
+		report("getcpu: vDSO", start);
+	}
+
+	if (&__rseq_size && __rseq_size) {
+		volatile uint32_t *cpu_id = (uint32_t *)
+			((char *)__builtin_thread_pointer() + __rseq_offset +
+			 sizeof(uint32_t));
+
+		start = now_ns();
+		for (i = 0; i < NR_LOOPS; i++)
+			cpu = *cpu_id;
+		report("getcpu: rseq cpu_id", start);
+	}
+}
+
+static void bench_clock(const char *name, clockid_t clk)
+{
+	char what[64];
+	struct timespec ts;
+	uint64_t start;
+	int i;
+
+	snprintf(what, sizeof(what), "clock_gettime(%s): syscall", name);
+	start = now_ns();
+	for (i = 0; i < NR_LOOPS; i++)
+		syscall(__NR_clock_gettime, clk, &ts);
+	report(what, start);
+
+	if (vdso_clock_gettime) {
+		snprintf(what, sizeof(what), "clock_gettime(%s): vDSO", name);
+		start = now_ns();
+		for (i = 0; i < NR_LOOPS; i++)
+			vdso_clock_gettime(clk, &ts);
+		report(what, start);
+	}
+
+	snprintf(what, sizeof(what), "clock_getres(%s): syscall", name);
+	start = now_ns();
+	for (i = 0; i < NR_LOOPS; i++)
+		syscall(__NR_clock_getres, clk, &ts);
+	report(what, start);
+
+	if (vdso_clock_getres) {
+		snprintf(what, sizeof(what), "clock_getres(%s): vDSO", name);
+		start = now_ns();
+		for (i = 0; i < NR_LOOPS; i++)
+			vdso_clock_getres(clk, &ts);
+		report(what, start);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	ksft_print_header();
+
+	fill_function_pointers();
+	if (!vdso_getcpu && !vdso_clock_gettime && !vdso_clock_getres)
+		ksft_exit_skip("no vDSO entry points found\n");
+
+	bench_getcpu();
+	bench_clock("MONOTONIC", CLOCK_MONOTONIC);
+	bench_clock("MONOTONIC_COARSE", CLOCK_MONOTONIC_COARSE);
+	bench_clock("REALTIME", CLOCK_REALTIME);
+	bench_clock("REALTIME_COARSE", CLOCK_REALTIME_COARSE);
+	bench_clock("TAI", CLOCK_TAI);
+	bench_clock("BOOTTIME", CLOCK_BOOTTIME);
+
+	ksft_exit_pass();
+}
@@ -0,0 +1,182 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * anon_large_folio.c: Map a 64K anonymous folio on first touch, unmap one
+ * of its pages and then the rest.
+ *
+ * Each PTE of the folio holds a folio reference, so the partial unmap must
+ * leave the remaining pages alone.  Best run on a CONFIG_DEBUG_VM kernel,
+ * where freeing a folio that is still mapped trips the bad page checks and
+ * taints the kernel.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../kselftest.h"
+
+#define FOLIO_SIZE	(64 * 1024)
+#define THP_64K_DIR	"/sys/kernel/mm/transparent_hugepage/hugepages-64kB"
+#define TAINT_BAD_PAGE	(1UL << 5)
+
+static size_t pagesize;
+
+static int read_file(const char *path, char *buf, size_t len)
+{
+	ssize_t ret;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	ret = read(fd, buf, len - 1);
+	close(fd);
+	if (ret < 0)
+		return -errno;
+	buf[ret] = '\0';
+	return 0;
+}
+
+static int write_file(const char *path, const char *buf)
+{
+	ssize_t ret;
+	int fd;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -errno;
+	ret = write(fd, buf, strlen(buf));
+	close(fd);
+	return ret < 0 ? -errno : 0;
+}
+
+static unsigned long read_ulong(const char *path)
+{
+	char buf[64];
+
+	if (read_file(path, buf, sizeof(buf)))
+		return 0;
+	return strtoul(buf, NULL, 0);
+}
+
+/* The active setting is the one in brackets, e.g. "always [never]" */
+static void active_setting(const char *buf, char *out, size_t len)
+{
+	const char *start = strchr(buf, '[');
+	const char *end = start ? strchr(start, ']') : NULL;
+
+	if (!start || !end || (size_t)(end - start) > len) {
+		snprintf(out, len, "never");
+		return;
+	}
+	snprintf(out, end - start, "%s", start + 1);
+}
+
+static char *map_aligned_folio(void)
+{
+	char *area, *folio;
+
+	/* Twice the size, so that a naturally aligned range fits inside */
+	area = mmap(NULL, 2 * FOLIO_SIZE, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (area == MAP_FAILED)
+		return NULL;
+
+	folio = (char *)(((uintptr_t)area + FOLIO_SIZE - 1) &
+			 ~(uintptr_t)(FOLIO_SIZE - 1));
+	if (folio != area)
+		munmap(area, folio - area);
+	munmap(folio + FOLIO_SIZE, area + FOLIO_SIZE - folio);
+	return folio;
+}
+
+static void test_partial_unmap(void)
+{
+	unsigned long allocs, taint;
+	size_t off;
+	char *folio;
+
+	taint = read_ulong("/proc/sys/kernel/tainted");
+	allocs = read_ulong(THP_64K_DIR "/stats/anon_fault_alloc");
+
+	folio = map_aligned_folio();
+	if (!folio) {
+		ksft_test_result_fail("mmap: %s\n", strerror(errno));
+		return;
+	}
+
+	/* One write fault populates the whole folio */
+	folio[0] = 1;
+	if (read_ulong(THP_64K_DIR "/stats/anon_fault_alloc") == allocs) {
+		munmap(folio, FOLIO_SIZE);
+		ksft_test_result_skip("no 64K folio allocated\n");
+		return;
+	}
+
+	for (off = 0; off < FOLIO_SIZE; off += pagesize)
+		folio[off] = (char)(off / pagesize + 1);
+
+	/* Drop the second page, the others must stay mapped and intact */
+	if (munmap(folio + pagesize, pagesize)) {
+		ksft_test_result_fail("partial munmap: %s\n", strerror(errno));
+		munmap(folio, FOLIO_SIZE);
+		return;
+	}
+
+	for (off = 0; off < FOLIO_SIZE; off += pagesize) {
+		if (off == pagesize)
+			continue;
+		if (folio[off] != (char)(off / pagesize + 1)) {
+			ksft_test_result_fail("page %zu changed after partial munmap\n",
+					      off / pagesize);
+			munmap(folio, FOLIO_SIZE);
+			return;
+		}
+	}
+
+	if (munmap(folio, FOLIO_SIZE)) {
+		ksft_test_result_fail("munmap: %s\n", strerror(errno));
+		return;
+	}
+
+	if ((read_ulong("/proc/sys/kernel/tainted") & TAINT_BAD_PAGE) &&
+	    !(taint & TAINT_BAD_PAGE)) {
+		ksft_test_result_fail("bad page state reported\n");
+		return;
+	}
+
+	ksft_test_result_pass("partial and full unmap of a 64K folio\n");
+}
+
+int main(int argc, char **argv)
+{
+	char buf[128], saved[32];
+	int ret;
+
+	ksft_print_header();
+	ksft_set_plan(1);
+
+	pagesize = getpagesize();
+	if (pagesize >= FOLIO_SIZE)
+		ksft_exit_skip("page size too large for a 64K folio\n");
+
+	if (read_file(THP_64K_DIR "/enabled", buf, sizeof(buf)))
+		ksft_exit_skip("64K anonymous folios not supported\n");
+	active_setting(buf, saved, sizeof(saved));
+
+	ret = write_file(THP_64K_DIR "/enabled", "always");
+	if (ret)
+		ksft_exit_skip("can't enable 64K folios: %s\n", strerror(-ret));
+
+	test_partial_unmap();
+
+	write_file(THP_64K_DIR "/enabled", saved);
+
+	ksft_finished();
+}